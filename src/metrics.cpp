@@ -0,0 +1,304 @@
+#include "metrics.h"
+
+#include <atomic>
+#include <thread>
+#include <sstream>
+#include <string>
+#include <iostream>
+#include <cstring>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+// Histogram bucket upper bounds in seconds shared by all histograms, the last bucket is +Inf
+const double HISTOGRAM_BUCKETS[] = {0.0001, 0.00025, 0.0005, 0.001, 0.002, 0.004, 0.008, 0.012, 0.0167, 0.020, 0.025, 0.0333, 0.050, 0.100, 0.250};
+const int HISTOGRAM_BUCKET_COUNT = sizeof(HISTOGRAM_BUCKETS) / sizeof(HISTOGRAM_BUCKETS[0]) + 1;
+
+struct HistogramDescription
+{
+    const char *Name;
+    const char *Help;
+};
+
+const HistogramDescription HISTOGRAMS[HISTOGRAM_COUNT] = {
+    {"pong_frame_time_seconds", "Time between consecutive frames."},
+    {"pong_input_latency_seconds", "Time from a key event to the simulation step that reads it."},
+    {"pong_simulation_jitter_seconds", "How late each simulation step starts compared to its schedule."}};
+
+const int MAX_METRICS_SHARDS = 8;
+
+// One shard per recording thread, each on its own cache lines so threads never contend. Threads
+// past MAX_METRICS_SHARDS share the last shard, which stays correct since updates are atomic.
+struct alignas(64) MetricsShard
+{
+    std::atomic<uint64_t> Counters[COUNTER_COUNT];
+    std::atomic<uint64_t> HistogramBuckets[HISTOGRAM_COUNT][HISTOGRAM_BUCKET_COUNT];
+    std::atomic<uint64_t> HistogramSumMicroseconds[HISTOGRAM_COUNT];
+};
+
+MetricsShard metricsShards[MAX_METRICS_SHARDS];
+std::atomic<int> metricsShardsInUse(0);
+std::atomic<double> metricsGauges[GAUGE_COUNT];
+
+std::atomic<bool> metricsServerRunning(false);
+std::thread metricsServerThread;
+int metricsListenSocket = -1;
+
+static MetricsShard &threadShard()
+{
+    thread_local MetricsShard *shard = nullptr;
+    if (!shard)
+    {
+        int index = metricsShardsInUse.fetch_add(1, std::memory_order_relaxed);
+        shard = &metricsShards[index < MAX_METRICS_SHARDS ? index : MAX_METRICS_SHARDS - 1];
+    }
+    return *shard;
+}
+
+void metricsIncrement(MetricsCounter counter, uint64_t amount)
+{
+    threadShard().Counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+void metricsSetGauge(MetricsGauge gauge, double value)
+{
+    metricsGauges[gauge].store(value, std::memory_order_relaxed);
+}
+
+void metricsObserve(MetricsHistogram histogram, double seconds)
+{
+    MetricsShard &shard = threadShard();
+    int bucket = 0;
+    while (bucket < HISTOGRAM_BUCKET_COUNT - 1 && seconds > HISTOGRAM_BUCKETS[bucket])
+    {
+        bucket++;
+    }
+    shard.HistogramBuckets[histogram][bucket].fetch_add(1, std::memory_order_relaxed);
+    shard.HistogramSumMicroseconds[histogram].fetch_add(static_cast<uint64_t>(seconds * 1e6), std::memory_order_relaxed);
+}
+
+static uint64_t sumCounter(MetricsCounter counter)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < MAX_METRICS_SHARDS; i++)
+    {
+        total += metricsShards[i].Counters[counter].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+// Estimate a quantile from the cumulative bucket counts by interpolating inside the bucket it falls in
+static double histogramQuantile(const uint64_t *cumulative, double quantile)
+{
+    uint64_t total = cumulative[HISTOGRAM_BUCKET_COUNT - 1];
+    if (total == 0)
+        return 0.0;
+
+    double rank = quantile * total;
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKET_COUNT - 1; bucket++)
+    {
+        if (cumulative[bucket] >= rank)
+        {
+            double lower = bucket == 0 ? 0.0 : HISTOGRAM_BUCKETS[bucket - 1];
+            uint64_t below = bucket == 0 ? 0 : cumulative[bucket - 1];
+            uint64_t inBucket = cumulative[bucket] - below;
+            double fraction = inBucket ? (rank - below) / inBucket : 1.0;
+            return lower + (HISTOGRAM_BUCKETS[bucket] - lower) * fraction;
+        }
+    }
+    return HISTOGRAM_BUCKETS[HISTOGRAM_BUCKET_COUNT - 2]; // quantile is in the +Inf bucket
+}
+
+static void writeCounter(std::ostringstream &out, const char *name, const char *help, uint64_t value)
+{
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " counter\n"
+        << name << " " << value << "\n";
+}
+
+static void writeGauge(std::ostringstream &out, const char *name, const char *help, double value)
+{
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " gauge\n"
+        << name << " " << value << "\n";
+}
+
+// Write a histogram, plus quantiles estimated from it for scrapers that don't compute them
+static void writeHistogram(std::ostringstream &out, MetricsHistogram histogram)
+{
+    const char *name = HISTOGRAMS[histogram].Name;
+
+    uint64_t cumulative[HISTOGRAM_BUCKET_COUNT];
+    uint64_t sumMicroseconds = 0;
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKET_COUNT; bucket++)
+    {
+        uint64_t count = 0;
+        for (int i = 0; i < MAX_METRICS_SHARDS; i++)
+        {
+            count += metricsShards[i].HistogramBuckets[histogram][bucket].load(std::memory_order_relaxed);
+        }
+        cumulative[bucket] = count + (bucket == 0 ? 0 : cumulative[bucket - 1]);
+    }
+    for (int i = 0; i < MAX_METRICS_SHARDS; i++)
+    {
+        sumMicroseconds += metricsShards[i].HistogramSumMicroseconds[histogram].load(std::memory_order_relaxed);
+    }
+
+    out << "# HELP " << name << " " << HISTOGRAMS[histogram].Help << "\n"
+        << "# TYPE " << name << " histogram\n";
+    for (int bucket = 0; bucket < HISTOGRAM_BUCKET_COUNT - 1; bucket++)
+    {
+        out << name << "_bucket{le=\"" << HISTOGRAM_BUCKETS[bucket] << "\"} " << cumulative[bucket] << "\n";
+    }
+    out << name << "_bucket{le=\"+Inf\"} " << cumulative[HISTOGRAM_BUCKET_COUNT - 1] << "\n"
+        << name << "_sum " << sumMicroseconds / 1e6 << "\n"
+        << name << "_count " << cumulative[HISTOGRAM_BUCKET_COUNT - 1] << "\n";
+
+    std::string quantileName = std::string(name).insert(strlen(name) - strlen("_seconds"), "_quantile");
+    out << "# HELP " << quantileName << " Quantiles estimated from " << name << ".\n"
+        << "# TYPE " << quantileName << " gauge\n";
+    const double quantiles[] = {0.5, 0.9, 0.99};
+    for (double quantile : quantiles)
+    {
+        out << quantileName << "{quantile=\"" << quantile << "\"} " << histogramQuantile(cumulative, quantile) << "\n";
+    }
+}
+
+static std::string formatMetrics()
+{
+    std::ostringstream out;
+
+    writeCounter(out, "pong_frames_total", "Frames rendered.", sumCounter(COUNTER_FRAMES));
+    writeCounter(out, "pong_late_frames_total", "Frames whose work took longer than the frame budget.", sumCounter(COUNTER_LATE_FRAMES));
+    writeCounter(out, "pong_simulation_steps_total", "Simulation steps run.", sumCounter(COUNTER_SIMULATION_STEPS));
+    writeCounter(out, "pong_input_events_total", "Keyboard events received.", sumCounter(COUNTER_INPUT_EVENTS));
+    writeCounter(out, "pong_paddle_hits_total", "Times the ball was returned by a paddle.", sumCounter(COUNTER_PADDLE_HITS));
+
+    out << "# HELP pong_goals_total Goals scored, by the scoring player.\n"
+        << "# TYPE pong_goals_total counter\n"
+        << "pong_goals_total{player=\"left\"} " << sumCounter(COUNTER_GOALS_LEFT) << "\n"
+        << "pong_goals_total{player=\"right\"} " << sumCounter(COUNTER_GOALS_RIGHT) << "\n";
+    out << "# HELP pong_matches_total Matches played, by the winning player.\n"
+        << "# TYPE pong_matches_total counter\n"
+        << "pong_matches_total{winner=\"left\"} " << sumCounter(COUNTER_MATCHES_WON_LEFT) << "\n"
+        << "pong_matches_total{winner=\"right\"} " << sumCounter(COUNTER_MATCHES_WON_RIGHT) << "\n";
+
+    writeGauge(out, "pong_rally_length", "Paddle hits since the last goal.", metricsGauges[GAUGE_RALLY_LENGTH].load(std::memory_order_relaxed));
+    writeGauge(out, "pong_ball_speed", "Ball speed after the last paddle hit, in normalized device units per second (the screen is 2 units tall).", metricsGauges[GAUGE_BALL_SPEED].load(std::memory_order_relaxed));
+    writeGauge(out, "pong_particles", "Live particles.", metricsGauges[GAUGE_PARTICLES].load(std::memory_order_relaxed));
+    writeGauge(out, "pong_stress_balls", "Balls in stress mode.", metricsGauges[GAUGE_STRESS_BALLS].load(std::memory_order_relaxed));
+
+    for (int histogram = 0; histogram < HISTOGRAM_COUNT; histogram++)
+    {
+        writeHistogram(out, static_cast<MetricsHistogram>(histogram));
+    }
+
+    return out.str();
+}
+
+static void sendAll(int socket, const std::string &data)
+{
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        ssize_t written = send(socket, data.data() + sent, data.size() - sent, SEND_FLAGS);
+        if (written <= 0)
+            return;
+        sent += written;
+    }
+}
+
+static void serveClient(int client)
+{
+    // the request line is all we need, give slow clients a second to send it
+    timeval timeout = {1, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+    int noSigpipe = 1;
+    setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &noSigpipe, sizeof(noSigpipe));
+#endif
+
+    char request[1024];
+    ssize_t received = recv(client, request, sizeof(request) - 1, 0);
+    if (received <= 0)
+        return;
+    request[received] = '\0';
+
+    std::string response;
+    if (strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0)
+    {
+        std::string body = formatMetrics();
+        response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                   std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    }
+    else
+    {
+        response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    }
+    sendAll(client, response);
+}
+
+static void metricsServerLoop()
+{
+    while (metricsServerRunning.load())
+    {
+        // wake up regularly to notice stopMetricsServer()
+        pollfd listenPoll = {metricsListenSocket, POLLIN, 0};
+        if (poll(&listenPoll, 1, 200) <= 0)
+            continue;
+
+        int client = accept(metricsListenSocket, NULL, NULL);
+        if (client < 0)
+            continue;
+        serveClient(client);
+        close(client);
+    }
+}
+
+// Start serving metrics on the loopback interface; the game runs fine without it if this fails
+bool startMetricsServer(unsigned short port)
+{
+    metricsListenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (metricsListenSocket < 0)
+    {
+        std::cout << "Failed to create metrics socket" << std::endl;
+        return false;
+    }
+
+    int reuseAddress = 1;
+    setsockopt(metricsListenSocket, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (bind(metricsListenSocket, (sockaddr *)&address, sizeof(address)) < 0 || listen(metricsListenSocket, 8) < 0)
+    {
+        std::cout << "Failed to listen for metrics on port " << port << std::endl;
+        close(metricsListenSocket);
+        metricsListenSocket = -1;
+        return false;
+    }
+
+    metricsServerRunning.store(true);
+    metricsServerThread = std::thread(metricsServerLoop);
+    return true;
+}
+
+void stopMetricsServer()
+{
+    if (!metricsServerRunning.exchange(false))
+        return;
+    metricsServerThread.join();
+    close(metricsListenSocket);
+    metricsListenSocket = -1;
+}
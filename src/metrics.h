@@ -0,0 +1,50 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <cstdint>
+
+// Live game metrics, served in Prometheus text format on http://127.0.0.1:<port>/metrics.
+// Counters and histograms are kept in per-thread shards updated with relaxed atomics, so
+// recording never takes a lock; the server thread sums the shards when scraped.
+
+enum MetricsCounter
+{
+    COUNTER_FRAMES,
+    COUNTER_LATE_FRAMES, // Frames whose work took longer than the frame budget
+    COUNTER_SIMULATION_STEPS,
+    COUNTER_INPUT_EVENTS,
+    COUNTER_PADDLE_HITS,
+    COUNTER_GOALS_LEFT,
+    COUNTER_GOALS_RIGHT,
+    COUNTER_MATCHES_WON_LEFT,
+    COUNTER_MATCHES_WON_RIGHT,
+    COUNTER_COUNT
+};
+
+enum MetricsGauge
+{
+    GAUGE_RALLY_LENGTH, // Paddle hits since the last goal
+    GAUGE_BALL_SPEED,   // Ball speed after the last paddle hit
+    GAUGE_PARTICLES,
+    GAUGE_STRESS_BALLS,
+    GAUGE_COUNT
+};
+
+enum MetricsHistogram
+{
+    HISTOGRAM_FRAME_TIME,        // Time between consecutive frames
+    HISTOGRAM_INPUT_LATENCY,     // Time from a key event to the simulation step that reads it
+    HISTOGRAM_SIMULATION_JITTER, // How late each simulation step starts compared to its schedule
+    HISTOGRAM_COUNT
+};
+
+const unsigned short METRICS_PORT = 9464;
+
+void metricsIncrement(MetricsCounter counter, uint64_t amount = 1);
+void metricsSetGauge(MetricsGauge gauge, double value);
+void metricsObserve(MetricsHistogram histogram, double seconds);
+
+bool startMetricsServer(unsigned short port);
+void stopMetricsServer();
+
+#endif
@@ -1,27 +1,118 @@
+#ifndef PONG_NO_GL
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#endif
 #include <iostream>
 #include <ft2build.h>
 #include <glm/glm.hpp>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <fstream>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <random>
+#ifdef __linux__
+#include <pthread.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 #include FT_FREETYPE_H
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include "metrics.h"
+#include "software_renderer.h"
+
+// What runSoftwareRenderer() draws into: a window, or memory for a fixed number of frames with the
+// game (--headless) or the capture scene (--software-capture)
+enum SoftwareRunMode
+{
+    SOFTWARE_RUN_WINDOW,
+    SOFTWARE_RUN_HEADLESS,
+    SOFTWARE_RUN_CAPTURE
+};
 
+#ifndef PONG_NO_GL
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
-void processInput(GLFWwindow *window, float deltaTime);
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
+int gameKeyFromGLFW(int key);
 void RenderText(unsigned int shaderProgram, std::string text, float x, float y, float scale, glm::vec3 color, int VAO, int VBO);
+void renderStressBalls(unsigned int shaderProgram, unsigned int VAO, unsigned int VBO, const struct GameSnapshot &snapshot);
+unsigned int compileShader(GLenum type, const char *source);
+void renderParticles(unsigned int shaderProgram, unsigned int VAO, unsigned int VBO);
+bool CaptureFramebuffer(const char *path, int width, int height);
+#endif
+void software_key_callback(SoftwareKey key, bool pressed);
+int gameKeyFromSoftware(SoftwareKey key);
+void recordKey(int key, bool pressed);
+double getTime();
+void processInput(float deltaTime);
 float CalculateTextWidth(const std::string &text, float scale);
+unsigned int DecodeUTF8(const std::string &text, size_t &i);
+const struct Character &GetCharacter(unsigned int codepoint);
+bool RasterizeGlyph(FT_Face font, unsigned int codepoint, struct Character &character, bool pinned);
+bool LoadFont();
+int LayoutHud(const struct GameSnapshot &snapshot, struct HudText lines[2]);
 void resetBall();
-unsigned int compileShader(GLenum type, const char *source);
+void bounceOffPaddle(float paddleYOffset, float positionY, float &velocityX, float &velocityY);
+void recordPaddleHit(float directionX);
+void recordGoal();
+void simulationThread();
+void stepSimulation(float deltaTime);
+void publishSnapshot();
+const struct GameSnapshot &acquireSnapshot();
+bool pinCurrentThreadToCore(int core);
+void readThreadPinning();
+void emitSnapshotParticles(const struct GameSnapshot &snapshot, unsigned int &seenPaddleHits, unsigned int &seenGoals);
+int runSoftwareRenderer(SoftwareRunMode mode, int frameCount, const char *imagePath);
+void BuildSoftwareScene(const struct GameSnapshot &snapshot, SoftwareScene &scene);
+SoftwareRect ndcRect(float left, float bottom, float right, float top, uint32_t color);
+bool WriteImage(const char *path, const uint32_t *pixels, int width, int height);
+bool ReadImage(const char *path, std::vector<unsigned char> &rgb, int &width, int &height);
+int compareCaptures(const char *firstPath, const char *secondPath);
+void startStressMode(int ballCount);
+void setStressBallCount(int ballCount);
+void spawnStressBall(int i);
+void stepStressBalls(float deltaTime);
+void buildStressBallGrid();
+void collideStressBalls(int i, int j);
+void updateParticles(float deltaTime);
+void updateParticlesScalar(int first, int count, float deltaTime, float damping);
+void (*selectParticleKernel())(int count, float deltaTime, float damping);
+void emitParticle(float x, float y, float velocityX, float velocityY, float lifetime, float size, glm::vec3 color);
+void emitBallTrail(float x, float y);
+void emitImpactBurst(float x, float y, float directionX);
+void emitGoalExplosion(float x, float y);
+void fillParticlePool();
+float randomFloat(std::minstd_rand &generator, float min, float max);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 
+// --capture (GL) and --software-capture render a fixed scene: the first frames of a game with the
+// simulation stopped, a fixed frame time and seeded particles, so both renderers draw the same image
+const double CAPTURE_FRAME_TIME = 1.0 / 60.0;
+const unsigned int CAPTURE_RANDOM_SEED = 1;
+
+// --compare <a.ppm> <b.ppm> passes when at most CAPTURE_MAX_DIFFERENT_PIXELS of the pixels have a
+// channel more than CAPTURE_CHANNEL_TOLERANCE apart. GL and the software renderer only disagree on
+// rounding at particle edges: on llvmpipe 0.006% of the pixels for the normal scene and 0.33% with
+// --fill-particles
+const int CAPTURE_CHANNEL_TOLERANCE = 8;
+const double CAPTURE_MAX_DIFFERENT_PIXELS = 0.005;
+
 const char *vertexShaderSource = R"(
     #version 330 core
     layout (location = 0) in vec3 aPos;
@@ -70,6 +161,36 @@ const char *backgroundFragmentShaderSource = R"(
     }
 )";
 
+const char *particleVertexShaderSource = R"(
+    #version 330 core
+    layout (location = 0) in vec2 aCorner;
+    layout (location = 1) in float aPositionX;
+    layout (location = 2) in float aPositionY;
+    layout (location = 3) in float aSize;
+    layout (location = 4) in float aAlpha;
+    layout (location = 5) in float aColorR;
+    layout (location = 6) in float aColorG;
+    layout (location = 7) in float aColorB;
+    out vec4 ParticleColor;
+    
+    void main()
+    {
+        gl_Position = vec4(aPositionX + aCorner.x * aSize, aPositionY + aCorner.y * aSize, 0.0, 1.0);
+        ParticleColor = vec4(aColorR, aColorG, aColorB, aAlpha);
+    }
+)";
+
+const char *particleFragmentShaderSource = R"(
+    #version 330 core
+    in vec4 ParticleColor;
+    out vec4 FragColor;
+    
+    void main()
+    {
+        FragColor = ParticleColor;
+    }
+)";
+
 const char *freeTypeVertexShaderSource = R"(
     #version 330 core
     layout (location = 0) in vec4 vertex;
@@ -115,20 +236,247 @@ bool gameOver = false;
 int MAX_SCORE = 3;
 int leftScore = 0;
 int rightScore = 0;
+int rallyLength = 0; // Paddle hits since the last goal
 
 const float SPEED_MULTIPLIER = 1.1f;
 
+// Stress mode variables
+// Stress mode replaces the single ball with up to MAX_STRESS_BALLS smaller balls that also collide
+// with each other. Candidate pairs come from a uniform grid rebuilt every step with a counting sort
+// into fixed arrays, so a step never touches the heap.
+// The arena between the paddles (1.6 x 2.0) holds 128 x 160 = 20480 balls of stressBallSize packed
+// edge to edge; MAX_STRESS_BALLS keeps them under half of that area so they still have room to move.
+const int MAX_STRESS_BALLS = 8192;
+const int STRESS_INITIAL_BALLS = 1024;
+const float stressBallSize = ballSize * 0.25f;
+const int STRESS_GRID_SIZE = 160; // 2.0 / STRESS_GRID_SIZE must be >= 2 * stressBallSize
+const int STRESS_GRID_CELLS = STRESS_GRID_SIZE * STRESS_GRID_SIZE;
+bool stressMode = false;
+int stressBallCount = 0;
+alignas(32) float stressBallPositionX[MAX_STRESS_BALLS];
+alignas(32) float stressBallPositionY[MAX_STRESS_BALLS];
+alignas(32) float stressBallVelocityX[MAX_STRESS_BALLS];
+alignas(32) float stressBallVelocityY[MAX_STRESS_BALLS];
+int stressBallCell[MAX_STRESS_BALLS];          // Grid cell of each ball for the current step
+int stressGridCellStart[STRESS_GRID_CELLS + 1]; // Balls of cell c are stressGridBalls[start[c], start[c + 1])
+int stressGridBalls[MAX_STRESS_BALLS];
+
+// Stress mode statistics, printed once per second
+int stressStepCount = 0;
+double stressStepTime = 0.0;
+double stressReportTime = 0.0;
+
+// Simulation thread variables
+// Input and physics run on their own thread at a fixed rate. Everything the renderer needs is copied
+// into an immutable snapshot and handed over through a lock-free triple buffer: the simulation
+// writes the back slot and swaps it with the middle one, the renderer swaps the middle slot with its
+// front one only when a newer snapshot was published, so neither thread ever waits for the other.
+const double SIMULATION_STEP = 1.0 / 240.0; // Fixed simulation step in seconds
+const int MAX_SIMULATION_CATCH_UP_STEPS = 8; // Steps run back to back before the simulation drops time
+int renderThreadCore = -1;     // Core to pin the render thread to, -1 leaves it to the OS scheduler
+int simulationThreadCore = -1; // Same for the simulation thread, both set from PONG_PIN_CORES
+std::minstd_rand simulationRandom; // Only used on the simulation thread (ball serve, stress balls)
+
+struct GameSnapshot
+{
+    float LeftPaddleYOffset;
+    float RightPaddleYOffset;
+    float BallPositionX;
+    float BallPositionY;
+    int LeftScore;
+    int RightScore;
+    bool IsPlaying;
+    bool GameOver;
+    bool StressMode;
+    unsigned int PaddleHits; // Running count, the renderer emits a burst for each new hit
+    float LastHitPositionX;
+    float LastHitPositionY;
+    float LastHitDirectionX;
+    unsigned int Goals; // Running count, the renderer emits an explosion for each new goal
+    float LastGoalPositionX;
+    float LastGoalPositionY;
+    int StressBallCount;
+    float StressBallPositionX[MAX_STRESS_BALLS];
+    float StressBallPositionY[MAX_STRESS_BALLS];
+};
+
+const int SNAPSHOT_UPDATED = 4; // Set in snapshotMiddle when it holds a snapshot the renderer hasn't seen
+GameSnapshot snapshots[3];
+int snapshotBack = 0;                // Only touched by the simulation thread
+std::atomic<int> snapshotMiddle(1);  // Slot index, plus SNAPSHOT_UPDATED
+int snapshotFront = 2;               // Only touched by the render thread
+std::atomic<bool> simulationRunning(false);
+
+// Simulation events published through the snapshot
+unsigned int paddleHits = 0;
+float lastHitPositionX = 0.0f;
+float lastHitPositionY = 0.0f;
+float lastHitDirectionX = 0.0f;
+unsigned int goals = 0;
+float lastGoalPositionX = 0.0f;
+float lastGoalPositionY = 0.0f;
+
+// Keys the game reacts to, the GL and software windows translate their own key codes to these
+enum GameKey
+{
+    KEY_ESCAPE,
+    KEY_ENTER,
+    KEY_UP,
+    KEY_DOWN,
+    KEY_W,
+    KEY_S,
+    KEY_R,
+    KEY_B,
+    KEY_EQUAL,
+    KEY_MINUS,
+    KEY_COUNT
+};
+
+// Keyboard state written by the key callback on the main thread and read by the simulation thread
+std::atomic<bool> keyStates[KEY_COUNT];
+std::atomic<double> lastKeyEventTime(0.0);
+
+// Framebuffer size reported by the resize callback on the main thread, applied by the render thread
+std::atomic<int> framebufferWidth(0);
+std::atomic<int> framebufferHeight(0);
+
+// Particle variables
+// Particles live in a fixed-capacity structure-of-arrays pool: live particles are packed in
+// [0, particleCount) so the SIMD update kernels run over contiguous floats, and dead
+// particles are removed by moving the last live particle into their slot.
+const int MAX_PARTICLES = 100000;
+const int PARTICLE_ATTRIBUTES = 7;      // posX, posY, size, alpha, r, g, b (uploaded to the GPU)
+const float PARTICLE_DRAG = 1.5f;       // Fraction of velocity lost per second
+const int TRAIL_PARTICLES_PER_FRAME = 6;
+const int IMPACT_PARTICLES = 400;
+const int GOAL_PARTICLES = 4000;
+int particleCount = 0;
+bool fillParticles = false; // --fill-particles: keep the pool at MAX_PARTICLES to measure the worst case
+std::minstd_rand particleRandom; // Only used on the render thread, seeded with CAPTURE_RANDOM_SEED by the captures
+alignas(32) float particlePositionX[MAX_PARTICLES];
+alignas(32) float particlePositionY[MAX_PARTICLES];
+alignas(32) float particleVelocityX[MAX_PARTICLES];
+alignas(32) float particleVelocityY[MAX_PARTICLES];
+alignas(32) float particleLife[MAX_PARTICLES];           // Remaining lifetime in seconds
+alignas(32) float particleInverseLifetime[MAX_PARTICLES]; // 1 / initial lifetime, used to fade out
+alignas(32) float particleSize[MAX_PARTICLES];
+alignas(32) float particleAlpha[MAX_PARTICLES];
+alignas(32) float particleColorR[MAX_PARTICLES];
+alignas(32) float particleColorG[MAX_PARTICLES];
+alignas(32) float particleColorB[MAX_PARTICLES];
+
 struct Character
 {
-    unsigned int TextureID; // ID handle of the glyph texture
+    unsigned int TextureID; // ID handle of the atlas page holding the glyph
+    int AtlasPage;          // Index of that page, for the software renderer
     glm::ivec2 Size;        // Size of glyph
     glm::ivec2 Bearing;     // Offset from baseline to left/top of glyph
     unsigned int Advance;   // Offset to advance to next glyph
+    glm::vec2 UVMin;        // Top-left of the glyph in the atlas page
+    glm::vec2 UVMax;        // Bottom-right of the glyph in the atlas page
+};
+
+// Glyph cache
+// Glyphs are rasterized on first use into fixed-size atlas pages split into equal cells. ASCII is
+// rasterized up front into pinned cells and looked up through a flat array; every other code point
+// goes through a hash map and is evicted least-recently-used once all cells are taken, so memory
+// stays bounded however many distinct code points a session sees. Code points PressStart2P lacks
+// (e.g. CJK or Arabic) come from the first fallback font that has them; ones no font has are drawn
+// as '?' and remembered so FreeType isn't asked again every frame.
+const int FONT_PIXEL_SIZE = 48;
+const int ATLAS_PAGE_SIZE = 512;                                  // Width and height of an atlas page in pixels
+const int GLYPH_CELL_SIZE = 64;                                   // Width and height of a glyph cell in pixels
+const int GLYPH_CELLS_PER_ROW = ATLAS_PAGE_SIZE / GLYPH_CELL_SIZE;
+const int GLYPH_CELLS_PER_PAGE = GLYPH_CELLS_PER_ROW * GLYPH_CELLS_PER_ROW;
+const int MAX_ATLAS_PAGES = 4;
+const int MAX_GLYPH_CELLS = GLYPH_CELLS_PER_PAGE * MAX_ATLAS_PAGES;
+const int MAX_MISSING_GLYPHS = 4096; // missingGlyphs is cleared once it reaches this size
+
+// Fallback fonts, tried in order after PressStart2P. PONG_FALLBACK_FONT may name another one.
+const char *FALLBACK_FONT_PATHS[] = {
+    "/System/Library/Fonts/Supplemental/Arial Unicode.ttf",
+    "/Library/Fonts/Arial Unicode.ttf",
+    "C:/Windows/Fonts/arialuni.ttf",
+    "/usr/share/fonts/opentype/noto/NotoSansCJK-Regular.ttc",
+    "/usr/share/fonts/truetype/droid/DroidSansFallbackFull.ttf",
+    "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf"};
+
+struct GlyphCell
+{
+    unsigned int Codepoint; // Code point cached in this cell
+    bool InUse;
+    bool Pinned;            // ASCII glyphs are never evicted
+    unsigned long LastUsed; // glyphUseCounter when last looked up, for LRU eviction
+    Character Glyph;
 };
 
-std::map<char, Character> Characters;
-int main()
+FT_Library ft;
+FT_Face face;
+std::vector<FT_Face> fallbackFaces;
+unsigned int atlasPages[MAX_ATLAS_PAGES];
+GlyphCell glyphCells[MAX_GLYPH_CELLS];
+unsigned char atlasPagePixels[MAX_ATLAS_PAGES][ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE]; // CPU copy of the atlas pages
+bool glyphAtlasOnGPU = false;                                                     // Whether atlasPages exist (GL renderer)
+Character asciiCharacters[128];
+std::unordered_map<unsigned int, int> glyphCellIndex; // Code point to glyph cell, non-ASCII only
+std::unordered_set<unsigned int> missingGlyphs;       // Code points no font has a glyph for
+unsigned long glyphUseCounter = 0;
+unsigned long glyphFrameStart = 0; // glyphUseCounter when the current frame started laying out text
+
+// A line of text drawn on top of the scene, in pixels from the bottom-left corner
+struct HudText
 {
+    std::string Text;
+    float X;
+    float Y;
+    float Scale;
+};
+int main(int argc, char **argv)
+{
+    readThreadPinning();
+
+    // --fill-particles can follow any of the options below
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--fill-particles")
+            fillParticles = true;
+    }
+
+    // --software renders on the CPU into an X11 window, --headless <frames> [image.ppm] into memory and
+    // --software-capture <frames> <image.ppm> renders the fixed capture scene into memory
+    // (frame counts below 1, or not numbers, render a single frame)
+    if (argc > 1 && std::string(argv[1]) == "--software")
+    {
+        return runSoftwareRenderer(SOFTWARE_RUN_WINDOW, 0, NULL);
+    }
+    if (argc > 2 && std::string(argv[1]) == "--headless")
+    {
+        return runSoftwareRenderer(SOFTWARE_RUN_HEADLESS, atoi(argv[2]) > 0 ? atoi(argv[2]) : 1, argc > 3 ? argv[3] : NULL);
+    }
+    if (argc > 3 && std::string(argv[1]) == "--software-capture")
+    {
+        return runSoftwareRenderer(SOFTWARE_RUN_CAPTURE, atoi(argv[2]) > 0 ? atoi(argv[2]) : 1, argv[3]);
+    }
+
+    // --compare <a.ppm> <b.ppm> checks two captures against the tolerance, exiting with 0 when they match
+    if (argc > 3 && std::string(argv[1]) == "--compare")
+    {
+        return compareCaptures(argv[2], argv[3]);
+    }
+
+#ifdef PONG_NO_GL
+    // built without OpenGL (-DPONG_NO_GL), the software renderer is the only one
+    return runSoftwareRenderer(SOFTWARE_RUN_WINDOW, 0, NULL);
+#else
+    // --capture <frames> <image.ppm> renders the fixed capture scene with GL and saves the last frame
+    int captureFrames = 0;
+    const char *captureImagePath = NULL;
+    if (argc > 3 && std::string(argv[1]) == "--capture")
+    {
+        captureFrames = atoi(argv[2]) > 0 ? atoi(argv[2]) : 1;
+        captureImagePath = argv[3];
+    }
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -151,6 +499,13 @@ int main()
     }
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    {
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        framebufferWidth.store(width);
+        framebufferHeight.store(height);
+    }
+    glfwSetKeyCallback(window, key_callback);
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
@@ -223,70 +578,30 @@ int main()
         glDeleteShader(backgroundFragmentShader);
     }
 
-    // free type setup
-    FT_Library ft;
-    if (FT_Init_FreeType(&ft))
-    {
-        std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
-        return -1;
-    }
-
-    FT_Face face;
-    if (FT_New_Face(ft, "assets/PressStart2P-Regular.ttf", 0, &face))
-    {
-        std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;
-        return -1;
-    }
-
-    FT_Set_Pixel_Sizes(face, 0, 48);
-
-    if (FT_Load_Char(face, 'X', FT_LOAD_RENDER))
-    {
-        std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
-        return -1;
-    }
-
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // disable byte-alignment restriction
 
-    for (unsigned char c = 0; c < 128; c++)
+    // create the (zero-filled) atlas pages
     {
-        // load character glyph
-        if (FT_Load_Char(face, c, FT_LOAD_RENDER))
+        std::vector<unsigned char> emptyPage(ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE, 0);
+        glGenTextures(MAX_ATLAS_PAGES, atlasPages);
+        for (int page = 0; page < MAX_ATLAS_PAGES; page++)
         {
-            std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
-            continue;
+            glBindTexture(GL_TEXTURE_2D, atlasPages[page]);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE, 0, GL_RED, GL_UNSIGNED_BYTE, emptyPage.data());
+            // set texture options
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         }
-        // generate texture
-        unsigned int texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RED,
-            face->glyph->bitmap.width,
-            face->glyph->bitmap.rows,
-            0,
-            GL_RED,
-            GL_UNSIGNED_BYTE,
-            face->glyph->bitmap.buffer);
-        // set texture options
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        // now store character for later use
-        Character character = {
-            texture,
-            glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-            glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-            static_cast<unsigned int>(face->glyph->advance.x)};
-        Characters.insert(std::pair<char, Character>(c, character));
+        glyphAtlasOnGPU = true;
     }
 
-    // clear free type resources
-    FT_Done_Face(face);
-    FT_Done_FreeType(ft);
+    // free type setup
+    if (!LoadFont())
+    {
+        return -1;
+    }
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -383,6 +698,98 @@ int main()
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
+    // Particle quad corners, expanded per instance in the particle vertex shader
+    float particleCornerVertices[] = {
+        -1.0f, 1.0f,
+        1.0f, 1.0f,
+        1.0f, -1.0f,
+
+        1.0f, -1.0f,
+        -1.0f, -1.0f,
+        -1.0f, 1.0f};
+
+    unsigned int particleCornerVBO, particleInstanceVBO, particleVAO;
+    glGenVertexArrays(1, &particleVAO);
+    glGenBuffers(1, &particleCornerVBO);
+    glGenBuffers(1, &particleInstanceVBO);
+
+    glBindVertexArray(particleVAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, particleCornerVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(particleCornerVertices), particleCornerVertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+
+    // The instance buffer mirrors the SoA pool: one tightly packed block per attribute
+    glBindBuffer(GL_ARRAY_BUFFER, particleInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * MAX_PARTICLES * PARTICLE_ATTRIBUTES, NULL, GL_STREAM_DRAW);
+    for (int i = 0; i < PARTICLE_ATTRIBUTES; i++)
+    {
+        glVertexAttribPointer(1 + i, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void *)(sizeof(float) * MAX_PARTICLES * i));
+        glEnableVertexAttribArray(1 + i);
+        glVertexAttribDivisor(1 + i, 1);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    // Build and compile the shader program for the particles
+    unsigned int particleShaderProgram;
+    {
+        unsigned int particleVertexShader = compileShader(GL_VERTEX_SHADER, particleVertexShaderSource);
+        unsigned int particleFragmentShader = compileShader(GL_FRAGMENT_SHADER, particleFragmentShaderSource);
+
+        if (!particleVertexShader || !particleFragmentShader)
+        {
+            std::cout << "Particle shader program creation failed." << std::endl;
+            return -1;
+        }
+
+        particleShaderProgram = glCreateProgram();
+        glAttachShader(particleShaderProgram, particleVertexShader);
+        glAttachShader(particleShaderProgram, particleFragmentShader);
+        glLinkProgram(particleShaderProgram);
+
+        // Check for linking errors
+        int success;
+        char infoLog[512];
+        glGetProgramiv(particleShaderProgram, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glGetProgramInfoLog(particleShaderProgram, 512, NULL, infoLog);
+            std::cout << "Particle shader program linking failed:\n"
+                      << infoLog << std::endl;
+            return -1;
+        }
+
+        glDeleteShader(particleVertexShader);
+        glDeleteShader(particleFragmentShader);
+    }
+
+    // Stress mode balls reuse the particle quad and shader; only the positions are per instance,
+    // the remaining particle attributes are set as constants before drawing
+    unsigned int stressBallVBO, stressBallVAO;
+    glGenVertexArrays(1, &stressBallVAO);
+    glGenBuffers(1, &stressBallVBO);
+
+    glBindVertexArray(stressBallVAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, particleCornerVBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+    glEnableVertexAttribArray(0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, stressBallVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * MAX_STRESS_BALLS * 2, NULL, GL_STREAM_DRAW);
+    for (int i = 0; i < 2; i++)
+    {
+        glVertexAttribPointer(1 + i, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void *)(sizeof(float) * MAX_STRESS_BALLS * i));
+        glEnableVertexAttribArray(1 + i);
+        glVertexAttribDivisor(1 + i, 1);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
     // Background vertices with texture coordinates
     float backgroundVertices[] = {
         // Position        // Texture Coordinates
@@ -460,184 +867,239 @@ int main()
     unsigned int textColorLoc = glGetUniformLocation(shaderProgram, "textColor");
     glUniform3f(textColorLoc, color.x, color.y, color.z);
 
-    double lastFrameTime = glfwGetTime();
-    double deltaTime = 0.0;
-
-    // render loop
-    // -----------
-    double targetFrameTime = 1.0 / 60.0; // 60 FPS
-    while (!glfwWindowShouldClose(window))
+    // The capture is drawn into an offscreen framebuffer of the logical window size, so it has the same
+    // size as the software renderer's image on HiDPI displays too
+    unsigned int captureFBO = 0;
+    unsigned int captureRBO = 0;
+    if (captureFrames > 0)
     {
-        double currentFrameTime = glfwGetTime();
-        deltaTime = currentFrameTime - lastFrameTime;
-        // Input
-        processInput(window, deltaTime);
+        glGenFramebuffers(1, &captureFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+        glGenRenderbuffers(1, &captureRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, captureRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SCR_WIDTH, SCR_HEIGHT);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, captureRBO);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "Failed to create the capture framebuffer" << std::endl;
+            return -1;
+        }
+        isPlaying = true;
+        particleRandom.seed(CAPTURE_RANDOM_SEED);
+    }
 
-        // Render
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+    // metrics are optional, keep playing if the port is taken. Started once every check above has passed,
+    // so the early returns never leave its thread running
+    if (startMetricsServer(METRICS_PORT))
+    {
+        std::cout << "Serving metrics on http://127.0.0.1:" << METRICS_PORT << "/metrics" << std::endl;
+    }
 
-        // Render the background
-        glUseProgram(backgroundShaderProgram);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glBindVertexArray(backgroundVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+    // Publish the initial state so the render loop has a snapshot before the simulation thread starts
+    publishSnapshot();
+    const GameSnapshot *snapshot = &acquireSnapshot();
 
-        // Render rectangles and ball
-        glUseProgram(shaderProgram); // Switch back to the original shader program
+    std::thread simulation;
+    if (captureFrames == 0)
+    {
+        simulationRunning.store(true);
+        simulation = std::thread(simulationThread);
+    }
 
-        if (leftScore == MAX_SCORE || rightScore == MAX_SCORE)
+    // Rendering runs on its own thread that owns the GL context, so a slow swap or vsync wait never
+    // holds up input: the main thread only waits for window events and hands keys to the simulation
+    std::atomic<bool> rendering(true);
+    glfwMakeContextCurrent(NULL);
+    std::thread render([&]()
+    {
+        glfwMakeContextCurrent(window);
+        pinCurrentThreadToCore(renderThreadCore);
+
+        // Particle events already turned into effects
+        unsigned int seenPaddleHits = snapshot->PaddleHits;
+        unsigned int seenGoals = snapshot->Goals;
+
+        double lastFrameTime = glfwGetTime();
+        double deltaTime = 0.0;
+        int viewportWidth = 0;
+        int viewportHeight = 0;
+        int capturedFrames = 0;
+        double captureTime = 0.0;
+        if (captureFrames > 0)
         {
-            gameOver = true;
-            isPlaying = false; // stop the game
+            glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
         }
 
-        if (!isPlaying)
+        // render loop
+        // -----------
+        double targetFrameTime = 1.0 / 60.0; // 60 FPS
+        while (rendering.load())
         {
-            if (gameOver)
+            double currentFrameTime = glfwGetTime();
+            deltaTime = captureFrames > 0 ? CAPTURE_FRAME_TIME : currentFrameTime - lastFrameTime;
+
+            // Apply window resizes reported to the main thread
+            int width = framebufferWidth.load(std::memory_order_relaxed);
+            int height = framebufferHeight.load(std::memory_order_relaxed);
+            if (captureFrames == 0 && (width != viewportWidth || height != viewportHeight))
             {
-                std::string winner = leftScore == MAX_SCORE ? "Left Player" : "Right Player";
-                std::string winnerMessage = winner + " Wins!";
-                std::string restartMessage = "Press R to Restart.";
+                glViewport(0, 0, width, height);
+                viewportWidth = width;
+                viewportHeight = height;
+            }
 
-                float textWidth2 = CalculateTextWidth(restartMessage, 0.5f);
-                float textXPosition2 = (SCR_WIDTH - textWidth2) / 2.0f;
-                float textYPosition2 = SCR_HEIGHT / 2.0f - 15.0f; // Adding half of the padding for the second line
+            // Latest simulation state, never waits for the simulation thread
+            snapshot = &acquireSnapshot();
 
-                RenderText(freeTypeShaderProgram, restartMessage, textXPosition2, textYPosition2, 0.5f, glm::vec3(1.0, 1.0f, 1.0f), freeTypeVAO, freeTypeVBO);
+            // Turn simulation events into particles
+            emitSnapshotParticles(*snapshot, seenPaddleHits, seenGoals);
 
-                float textWidth1 = CalculateTextWidth(winnerMessage, 0.5f);
-                float textXPosition1 = (SCR_WIDTH - textWidth1) / 2.0f;
-                float textYPosition1 = SCR_HEIGHT / 2.0f + 15.0f; // Subtracting half of the padding for the first line
+            // Render
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
 
-                RenderText(freeTypeShaderProgram, winnerMessage, textXPosition1, textYPosition1, 0.5f, glm::vec3(1.0f, 1.0f, 1.0f), freeTypeVAO, freeTypeVBO);
-            }
-            else
-            {
-                glUseProgram(freeTypeShaderProgram);
-                unsigned int projectionLoc = glGetUniformLocation(freeTypeShaderProgram, "projection");
-                glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-                std::string playMessage = "Press Enter to Play :)";
-                float textScale = 0.5f; // Adjust this value to change the size of the text
-                float textWidth = CalculateTextWidth(playMessage, textScale);
-                float textHeight = 48 * textScale; // 48 is the size you set for the font. Adjust based on your font's characteristics
-                float textXPosition = (SCR_WIDTH - textWidth) / 2.0f;
-                float textYPosition = (SCR_HEIGHT - textHeight) / 2.0f;
-                RenderText(freeTypeShaderProgram, playMessage, textXPosition, textYPosition, textScale, glm::vec3(1.0f, 1.0f, 1.0f), freeTypeVAO, freeTypeVBO);
-            }
-        }
-        else
-        {
+            // Render the background
+            glUseProgram(backgroundShaderProgram);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glBindVertexArray(backgroundVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
 
-            // Update vertex data for both rectangles based on their Y-axis offsets
-            float updatedRectangleVertices[36];
-            for (int i = 0; i < 36; ++i)
-            {
-                updatedRectangleVertices[i] = rectangleVertices[i];
-            }
-            // Update Y-coordinates for both triangles of the left rectangle
-            for (int i = 1; i < 18; i += 3)
-            {
-                updatedRectangleVertices[i] += leftRectangleYOffset;
-            }
+            // Update and render the particles (drawn behind paddles, ball and text)
+            updateParticles(deltaTime);
+            renderParticles(particleShaderProgram, particleVAO, particleInstanceVBO);
+
+            // Render rectangles and ball
+            glUseProgram(shaderProgram); // Switch back to the original shader program
 
-            // Update Y-coordinates for both triangles of the right rectangle
-            for (int i = 19; i < 36; i += 3)
+            if (snapshot->IsPlaying)
             {
-                updatedRectangleVertices[i] += rightRectangleYOffset;
-            }
+                // Update vertex data for both rectangles based on their Y-axis offsets
+                float updatedRectangleVertices[36];
+                for (int i = 0; i < 36; ++i)
+                {
+                    updatedRectangleVertices[i] = rectangleVertices[i];
+                }
+                // Update Y-coordinates for both triangles of the left rectangle
+                for (int i = 1; i < 18; i += 3)
+                {
+                    updatedRectangleVertices[i] += snapshot->LeftPaddleYOffset;
+                }
 
-            // Update the VBO with the new vertex data for the rectangles
-            glBindBuffer(GL_ARRAY_BUFFER, rectangleVBO);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(updatedRectangleVertices), updatedRectangleVertices);
+                // Update Y-coordinates for both triangles of the right rectangle
+                for (int i = 19; i < 36; i += 3)
+                {
+                    updatedRectangleVertices[i] += snapshot->RightPaddleYOffset;
+                }
 
-            // Ball movement
-            ballPositionX += ballVelocityX * deltaTime;
-            ballPositionY += ballVelocityY * deltaTime;
+                // Update the VBO with the new vertex data for the rectangles
+                glBindBuffer(GL_ARRAY_BUFFER, rectangleVBO);
+                glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(updatedRectangleVertices), updatedRectangleVertices);
 
-            // Wall collision
-            if (ballPositionY + ballSize >= 1.0f || ballPositionY - ballSize <= -1.0f)
-            {
-                ballVelocityY = -ballVelocityY;
-            }
+                if (!snapshot->StressMode)
+                {
+                    // Update ball vertex data based on its position
+                    float updatedBallVertices[18];
+                    for (int i = 0; i < 18; i += 3)
+                    {
+                        updatedBallVertices[i] = ballVertices[i] + snapshot->BallPositionX;
+                        updatedBallVertices[i + 1] = ballVertices[i + 1] + snapshot->BallPositionY;
+                        updatedBallVertices[i + 2] = ballVertices[i + 2];
+                    }
+
+                    // Update the VBO with the new vertex data for the ball
+                    glBindBuffer(GL_ARRAY_BUFFER, ballVBO);
+                    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(updatedBallVertices), updatedBallVertices);
+                }
 
-            // Paddle collision
-            // Paddle collision
-            if (ballPositionX - ballSize <= -0.8f && ballPositionY <= leftRectangleYOffset + 0.1f && ballPositionY >= leftRectangleYOffset - 0.1f)
-            {
-                ballVelocityX = -ballVelocityX * SPEED_MULTIPLIER;
-                float relativeIntersectionY = (leftRectangleYOffset - ballPositionY) / (rectangleHeight / 2);
-                ballVelocityY = relativeIntersectionY * 1.5f * SPEED_MULTIPLIER; // 1.5f determines the angle, adjust accordingly
-            }
+                // Activate the shader program
+                glUseProgram(shaderProgram);
 
-            else if (ballPositionX + ballSize >= 0.8f && ballPositionY <= rightRectangleYOffset + 0.1f && ballPositionY >= rightRectangleYOffset - 0.1f)
-            {
-                ballVelocityX = -ballVelocityX * SPEED_MULTIPLIER;
-                float relativeIntersectionY = (rightRectangleYOffset - ballPositionY) / (rectangleHeight / 2);
-                ballVelocityY = relativeIntersectionY * 1.5f * SPEED_MULTIPLIER; // 1.5f determines the angle, adjust accordingly
-            }
-            // Reset ball if it goes past the left or right edges
-            if (ballPositionX - ballSize <= -1.0f || ballPositionX + ballSize >= 1.0f)
-            {
-                if (ballPositionX - ballSize <= -1.0f)
+                // Render the rectangles
+                glBindVertexArray(rectangleVAO);
+                glDrawArrays(GL_TRIANGLES, 0, 12);
+
+                // Render the ball(s)
+                if (snapshot->StressMode)
                 {
-                    rightScore++; // Increment right player's score when the ball passes the left edge
+                    renderStressBalls(particleShaderProgram, stressBallVAO, stressBallVBO, *snapshot);
                 }
-                if (ballPositionX + ballSize >= 1.0f)
+                else
                 {
-                    leftScore++; // Increment left player's score when the ball passes the right edge
+                    glBindVertexArray(ballVAO);
+                    glDrawArrays(GL_TRIANGLES, 0, 6);
                 }
-                resetBall();
             }
 
-            // Update ball vertex data based on its position
-            float updatedBallVertices[18];
-            for (int i = 0; i < 18; i += 3)
+            // render the text
+            glUseProgram(freeTypeShaderProgram);
+            unsigned int projectionLoc = glGetUniformLocation(freeTypeShaderProgram, "projection");
+            glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
+
+            glyphFrameStart = glyphUseCounter;
+            HudText hudLines[2];
+            int hudLineCount = LayoutHud(*snapshot, hudLines);
+            for (int i = 0; i < hudLineCount; i++)
             {
-                updatedBallVertices[i] = ballVertices[i] + ballPositionX;
-                updatedBallVertices[i + 1] = ballVertices[i + 1] + ballPositionY;
-                updatedBallVertices[i + 2] = ballVertices[i + 2];
+                RenderText(freeTypeShaderProgram, hudLines[i].Text, hudLines[i].X, hudLines[i].Y, hudLines[i].Scale, glm::vec3(1.0f, 1.0f, 1.0f), freeTypeVAO, freeTypeVBO);
             }
 
-            // Update the VBO with the new vertex data for the ball
-            glBindBuffer(GL_ARRAY_BUFFER, ballVBO);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(updatedBallVertices), updatedBallVertices);
-
-            // Activate the shader program
-            glUseProgram(shaderProgram);
+            // Time the capture frames up to the point the GPU is done, then save the last one and stop
+            if (captureFrames > 0)
+            {
+                glFinish();
+                captureTime += glfwGetTime() - currentFrameTime;
+                if (++capturedFrames == captureFrames)
+                {
+                    std::cout << "GL renderer: " << capturedFrames << " frames, " << captureTime / capturedFrames * 1000.0 << " ms/frame" << std::endl;
+                    if (!CaptureFramebuffer(captureImagePath, SCR_WIDTH, SCR_HEIGHT))
+                    {
+                        std::cout << "Failed to write image: " << captureImagePath << std::endl;
+                    }
+                    rendering.store(false);
+                    glfwPostEmptyEvent(); // wake the main thread so it sees the render loop is done
+                }
+                continue;
+            }
 
-            // Render the rectangles
-            glBindVertexArray(rectangleVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 12);
+            // glfw: swap buffers, the main thread handles the IO events
+            glfwSwapBuffers(window);
 
-            // Render the ball
-            glBindVertexArray(ballVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+            double frameEndTime = glfwGetTime();
+            double frameDuration = frameEndTime - currentFrameTime;
 
-            // render the score
-            glUseProgram(freeTypeShaderProgram);
-            unsigned int projectionLoc = glGetUniformLocation(freeTypeShaderProgram, "projection");
-            glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
+            metricsIncrement(COUNTER_FRAMES);
+            metricsObserve(HISTOGRAM_FRAME_TIME, deltaTime);
+            metricsSetGauge(GAUGE_PARTICLES, particleCount);
+            if (frameDuration > targetFrameTime)
+            {
+                metricsIncrement(COUNTER_LATE_FRAMES);
+            }
 
-            std::string scoreText = std::to_string(leftScore) + " - " + std::to_string(rightScore); // Update the score text
-            float textWidth = CalculateTextWidth(scoreText, 1.0f);                                  // Assuming a scale of 1.0
-            float scoreXPosition = (SCR_WIDTH - textWidth) / 2.0f;
-            float scoreYPosition = SCR_HEIGHT - 70.0f; // 50 pixels from the top, adjust as necessary
-            RenderText(freeTypeShaderProgram, scoreText, scoreXPosition, scoreYPosition, 1.0f, glm::vec3(1.0f, 1.0f, 1.0f), freeTypeVAO, freeTypeVBO);
+            if (frameDuration < targetFrameTime)
+            {
+                std::this_thread::sleep_for(std::chrono::duration<double>(targetFrameTime - frameDuration));
+            }
+            lastFrameTime = currentFrameTime;
         }
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        glfwSwapBuffers(window);
-        glfwPollEvents();
 
-        double frameEndTime = glfwGetTime();
-        double frameDuration = frameEndTime - currentFrameTime;
+        glfwMakeContextCurrent(NULL);
+    });
 
-        if (frameDuration < targetFrameTime)
-        {
-            glfwWaitEventsTimeout(targetFrameTime - frameDuration);
-        }
-        lastFrameTime = currentFrameTime;
+    // event loop
+    // ----------
+    while (!glfwWindowShouldClose(window) && rendering.load())
+    {
+        glfwWaitEvents();
+    }
+
+    rendering.store(false);
+    render.join();
+    glfwMakeContextCurrent(window);
+
+    if (simulation.joinable())
+    {
+        simulationRunning.store(false);
+        simulation.join();
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
@@ -646,47 +1108,78 @@ int main()
     glDeleteBuffers(1, &rectangleVBO);
     glDeleteVertexArrays(1, &backgroundVAO);
     glDeleteBuffers(1, &backgroundVBO);
+    glDeleteVertexArrays(1, &particleVAO);
+    glDeleteBuffers(1, &particleCornerVBO);
+    glDeleteBuffers(1, &particleInstanceVBO);
+    glDeleteVertexArrays(1, &stressBallVAO);
+    glDeleteBuffers(1, &stressBallVBO);
     glDeleteTextures(1, &texture);
+    glDeleteTextures(MAX_ATLAS_PAGES, atlasPages);
     glDeleteProgram(shaderProgram);
     glDeleteProgram(backgroundShaderProgram);
+    glDeleteProgram(particleShaderProgram);
+    if (captureFrames > 0)
+    {
+        glDeleteRenderbuffers(1, &captureRBO);
+        glDeleteFramebuffers(1, &captureFBO);
+    }
+
+    // clear free type resources
+    FT_Done_Face(face);
+    FT_Done_FreeType(ft);
+
+    stopMetricsServer();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     glfwTerminate();
     return 0;
+#endif
 }
 
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-void processInput(GLFWwindow *window, float deltaTime)
+// process all input: read the key states recorded by key_callback and react accordingly (simulation thread)
+void processInput(float deltaTime)
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
-
-    if (glfwGetKey(window, GLFW_KEY_ENTER) == GLFW_PRESS)
+    if (keyStates[KEY_ENTER].load(std::memory_order_relaxed))
         isPlaying = true; // Start the game when Enter is pressed
 
-    if (isPlaying)
+    if (keyStates[KEY_B].load(std::memory_order_relaxed) && !isPlaying && !gameOver)
+        startStressMode(STRESS_INITIAL_BALLS); // Start the multi-ball stress mode when B is pressed
+
+    if (stressMode)
     {
-        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-            glfwSetWindowShouldClose(window, true);
+        // +/- double or halve the number of balls, once per key press
+        static bool moreBallsWasPressed = false;
+        static bool fewerBallsWasPressed = false;
+        bool moreBallsPressed = keyStates[KEY_EQUAL].load(std::memory_order_relaxed);
+        bool fewerBallsPressed = keyStates[KEY_MINUS].load(std::memory_order_relaxed);
+        if (moreBallsPressed && !moreBallsWasPressed)
+            setStressBallCount(stressBallCount * 2);
+        if (fewerBallsPressed && !fewerBallsWasPressed)
+            setStressBallCount(stressBallCount / 2);
+        moreBallsWasPressed = moreBallsPressed;
+        fewerBallsWasPressed = fewerBallsPressed;
+    }
 
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS && leftRectangleYOffset + rectangleHeight / 2 < 1.0f)
+    if (isPlaying)
+    {
+        if (keyStates[KEY_W].load(std::memory_order_relaxed) && leftRectangleYOffset + rectangleHeight / 2 < 1.0f)
             leftRectangleYOffset += moveSpeed * deltaTime;
         ;
 
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS && leftRectangleYOffset - rectangleHeight / 2 > -1.0f)
+        if (keyStates[KEY_S].load(std::memory_order_relaxed) && leftRectangleYOffset - rectangleHeight / 2 > -1.0f)
             leftRectangleYOffset -= moveSpeed * deltaTime;
         ;
 
-        if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS && rightRectangleYOffset + rectangleHeight / 2 < 1.0f)
+        if (keyStates[KEY_UP].load(std::memory_order_relaxed) && rightRectangleYOffset + rectangleHeight / 2 < 1.0f)
             rightRectangleYOffset += moveSpeed * deltaTime;
         ;
 
-        if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS && rightRectangleYOffset - rectangleHeight / 2 > -1.0f)
+        if (keyStates[KEY_DOWN].load(std::memory_order_relaxed) && rightRectangleYOffset - rectangleHeight / 2 > -1.0f)
             rightRectangleYOffset -= moveSpeed * deltaTime;
         ;
     }
 
-    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && gameOver)
+    if (keyStates[KEY_R].load(std::memory_order_relaxed) && gameOver)
     {
         leftScore = 0;
         rightScore = 0;
@@ -695,42 +1188,150 @@ void processInput(GLFWwindow *window, float deltaTime)
         gameOver = false;
         isPlaying = true;
     }
+
+    if (keyStates[KEY_R].load(std::memory_order_relaxed) && stressMode)
+    {
+        // R also leaves the stress mode, restarting a normal game
+        stressMode = false;
+        stressBallCount = 0;
+        leftScore = 0;
+        rightScore = 0;
+        rallyLength = 0;
+        resetBall();
+        isPlaying = true;
+    }
 }
 
-// glfw: whenever the window size changed (by OS or user resize) this callback function executes
-void framebuffer_size_callback(GLFWwindow *window, int width, int height)
+#ifndef PONG_NO_GL
+// glfw: count every key press, repeat and release as an input event for the metrics and record it
+// for the simulation thread
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
 {
-    glViewport(0, 0, width, height);
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+
+    recordKey(gameKeyFromGLFW(key), action != GLFW_RELEASE);
 }
 
-void RenderText(unsigned int shaderProgram, std::string text, float x, float y, float scale, glm::vec3 color, int VAO, int VBO)
+int gameKeyFromGLFW(int key)
 {
-    // Activate corresponding render state
-    glUseProgram(shaderProgram);
-    glUniform3f(glGetUniformLocation(shaderProgram, "textColor"), color.x, color.y, color.z);
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(VAO);
-
-    // iterate through all characters
-    std::string::const_iterator c;
-    for (c = text.begin(); c != text.end(); c++)
+    switch (key)
     {
-        Character ch = Characters[*c];
-
-        float xpos = x + ch.Bearing.x * scale;
-        float ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
+    case GLFW_KEY_ESCAPE:
+        return KEY_ESCAPE;
+    case GLFW_KEY_ENTER:
+        return KEY_ENTER;
+    case GLFW_KEY_UP:
+        return KEY_UP;
+    case GLFW_KEY_DOWN:
+        return KEY_DOWN;
+    case GLFW_KEY_W:
+        return KEY_W;
+    case GLFW_KEY_S:
+        return KEY_S;
+    case GLFW_KEY_R:
+        return KEY_R;
+    case GLFW_KEY_B:
+        return KEY_B;
+    case GLFW_KEY_EQUAL:
+        return KEY_EQUAL;
+    case GLFW_KEY_MINUS:
+        return KEY_MINUS;
+    default:
+        return -1;
+    }
+}
+#endif
 
-        float w = ch.Size.x * scale;
-        float h = ch.Size.y * scale;
-        // update VBO for each character
-        float vertices[6][4] = {
-            {xpos, ypos + h, 0.0f, 0.0f},
-            {xpos, ypos, 0.0f, 1.0f},
-            {xpos + w, ypos, 1.0f, 1.0f},
+// software window: same as key_callback, ESC is handled by the software render loop
+void software_key_callback(SoftwareKey key, bool pressed)
+{
+    recordKey(gameKeyFromSoftware(key), pressed);
+}
 
-            {xpos, ypos + h, 0.0f, 0.0f},
-            {xpos + w, ypos, 1.0f, 1.0f},
-            {xpos + w, ypos + h, 1.0f, 0.0f}};
+int gameKeyFromSoftware(SoftwareKey key)
+{
+    switch (key)
+    {
+    case SOFTWARE_KEY_ESCAPE:
+        return KEY_ESCAPE;
+    case SOFTWARE_KEY_ENTER:
+        return KEY_ENTER;
+    case SOFTWARE_KEY_UP:
+        return KEY_UP;
+    case SOFTWARE_KEY_DOWN:
+        return KEY_DOWN;
+    case SOFTWARE_KEY_W:
+        return KEY_W;
+    case SOFTWARE_KEY_S:
+        return KEY_S;
+    case SOFTWARE_KEY_R:
+        return KEY_R;
+    case SOFTWARE_KEY_B:
+        return KEY_B;
+    case SOFTWARE_KEY_EQUAL:
+        return KEY_EQUAL;
+    case SOFTWARE_KEY_MINUS:
+        return KEY_MINUS;
+    default:
+        return -1;
+    }
+}
+
+// Record a key state for the simulation thread, shared by the GL and software windows
+void recordKey(int key, bool pressed)
+{
+    metricsIncrement(COUNTER_INPUT_EVENTS);
+
+    if (key < 0 || key >= KEY_COUNT)
+        return;
+    keyStates[key].store(pressed, std::memory_order_relaxed);
+    lastKeyEventTime.store(getTime(), std::memory_order_release);
+}
+
+// Seconds on a monotonic clock; unlike glfwGetTime() it works without GLFW (software renderer)
+double getTime()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifndef PONG_NO_GL
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+void framebuffer_size_callback(GLFWwindow *window, int width, int height)
+{
+    // the render thread owns the GL context and applies the viewport on its next frame
+    framebufferWidth.store(width, std::memory_order_relaxed);
+    framebufferHeight.store(height, std::memory_order_relaxed);
+}
+
+void RenderText(unsigned int shaderProgram, std::string text, float x, float y, float scale, glm::vec3 color, int VAO, int VBO)
+{
+    // Activate corresponding render state
+    glUseProgram(shaderProgram);
+    glUniform3f(glGetUniformLocation(shaderProgram, "textColor"), color.x, color.y, color.z);
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(VAO);
+
+    // iterate through all code points
+    size_t i = 0;
+    while (i < text.size())
+    {
+        const Character &ch = GetCharacter(DecodeUTF8(text, i));
+
+        float xpos = x + ch.Bearing.x * scale;
+        float ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
+
+        float w = ch.Size.x * scale;
+        float h = ch.Size.y * scale;
+        // update VBO for each character
+        float vertices[6][4] = {
+            {xpos, ypos + h, ch.UVMin.x, ch.UVMin.y},
+            {xpos, ypos, ch.UVMin.x, ch.UVMax.y},
+            {xpos + w, ypos, ch.UVMax.x, ch.UVMax.y},
+
+            {xpos, ypos + h, ch.UVMin.x, ch.UVMin.y},
+            {xpos + w, ypos, ch.UVMax.x, ch.UVMax.y},
+            {xpos + w, ypos + h, ch.UVMax.x, ch.UVMin.y}};
         // render glyph texture over quad
         glBindTexture(GL_TEXTURE_2D, ch.TextureID);
         // update content of VBO memory
@@ -745,41 +1346,1360 @@ void RenderText(unsigned int shaderProgram, std::string text, float x, float y,
     glBindVertexArray(0);
     glBindTexture(GL_TEXTURE_2D, 0);
 }
+#endif
 
 float CalculateTextWidth(const std::string &text, float scale)
 {
     float width = 0.0f;
-    for (char c : text)
+    size_t i = 0;
+    while (i < text.size())
     {
-        Character ch = Characters[c];
+        const Character &ch = GetCharacter(DecodeUTF8(text, i));
         width += (ch.Advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64)
     }
     return width;
 }
 
+// Load the font and rasterize the ASCII glyphs, needs the atlas pages to exist when drawing with GL
+bool LoadFont()
+{
+    if (FT_Init_FreeType(&ft))
+    {
+        std::cout << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+        return false;
+    }
+
+    if (FT_New_Face(ft, "assets/PressStart2P-Regular.ttf", 0, &face))
+    {
+        std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;
+        return false;
+    }
+
+    FT_Set_Pixel_Sizes(face, 0, FONT_PIXEL_SIZE);
+
+    // fallback fonts are optional, missing ones are skipped
+    std::vector<const char *> fallbackPaths;
+    const char *fallbackFont = getenv("PONG_FALLBACK_FONT");
+    if (fallbackFont != NULL)
+        fallbackPaths.push_back(fallbackFont);
+    for (const char *path : FALLBACK_FONT_PATHS)
+        fallbackPaths.push_back(path);
+    for (const char *path : fallbackPaths)
+    {
+        FT_Face fallbackFace;
+        if (FT_New_Face(ft, path, 0, &fallbackFace))
+            continue;
+        FT_Set_Pixel_Sizes(fallbackFace, 0, FONT_PIXEL_SIZE);
+        fallbackFaces.push_back(fallbackFace);
+    }
+
+    if (FT_Load_Char(face, 'X', FT_LOAD_RENDER))
+    {
+        std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
+        return false;
+    }
+
+    // preload the ASCII glyphs into pinned cells
+    for (unsigned int c = 0; c < 128; c++)
+    {
+        if (!RasterizeGlyph(face, c, asciiCharacters[c], true))
+        {
+            std::cout << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
+        }
+    }
+
+    return true;
+}
+
+// Decode the UTF-8 sequence starting at text[i] and move i past it. Malformed sequences decode
+// to U+FFFD and skip a single byte.
+unsigned int DecodeUTF8(const std::string &text, size_t &i)
+{
+    const unsigned int replacementCharacter = 0xFFFD;
+    unsigned char lead = text[i++];
+    if (lead < 0x80)
+        return lead;
+
+    int length;
+    unsigned int codepoint;
+    if ((lead & 0xE0) == 0xC0)
+    {
+        length = 1;
+        codepoint = lead & 0x1F;
+    }
+    else if ((lead & 0xF0) == 0xE0)
+    {
+        length = 2;
+        codepoint = lead & 0x0F;
+    }
+    else if ((lead & 0xF8) == 0xF0)
+    {
+        length = 3;
+        codepoint = lead & 0x07;
+    }
+    else
+    {
+        return replacementCharacter;
+    }
+
+    if (i + length > text.size())
+        return replacementCharacter;
+    for (int k = 0; k < length; k++)
+    {
+        unsigned char continuation = text[i + k];
+        if ((continuation & 0xC0) != 0x80)
+            return replacementCharacter;
+        codepoint = (codepoint << 6) | (continuation & 0x3F);
+    }
+
+    // reject overlong encodings, surrogates and values past U+10FFFF
+    const unsigned int minimumCodepoint[4] = {0, 0x80, 0x800, 0x10000};
+    if (codepoint < minimumCodepoint[length] || (codepoint >= 0xD800 && codepoint <= 0xDFFF) || codepoint > 0x10FFFF)
+        return replacementCharacter;
+
+    i += length;
+    return codepoint;
+}
+
+// Look up a glyph, rasterizing it into the atlas on first use
+const Character &GetCharacter(unsigned int codepoint)
+{
+    if (codepoint < 128)
+        return asciiCharacters[codepoint];
+
+    glyphUseCounter++;
+    std::unordered_map<unsigned int, int>::iterator cached = glyphCellIndex.find(codepoint);
+    if (cached != glyphCellIndex.end())
+    {
+        GlyphCell &cell = glyphCells[cached->second];
+        cell.LastUsed = glyphUseCounter;
+        return cell.Glyph;
+    }
+
+    if (missingGlyphs.count(codepoint))
+        return asciiCharacters['?'];
+
+    // take the glyph from the first font that has it
+    FT_Face font = NULL;
+    if (FT_Get_Char_Index(face, codepoint) != 0)
+        font = face;
+    for (size_t i = 0; font == NULL && i < fallbackFaces.size(); i++)
+    {
+        if (FT_Get_Char_Index(fallbackFaces[i], codepoint) != 0)
+            font = fallbackFaces[i];
+    }
+
+    // code points no font has a glyph for are drawn as '?' without taking up a cell
+    if (font == NULL)
+    {
+        if (missingGlyphs.size() >= MAX_MISSING_GLYPHS)
+            missingGlyphs.clear();
+        missingGlyphs.insert(codepoint);
+        return asciiCharacters['?'];
+    }
+
+    // also '?' when every cell is pinned or already used this frame, but only for this frame
+    Character character;
+    if (!RasterizeGlyph(font, codepoint, character, false))
+        return asciiCharacters['?'];
+    return glyphCells[glyphCellIndex[codepoint]].Glyph;
+}
+
+// Render a glyph with FreeType and copy it into a free atlas cell, evicting the least recently used
+// unpinned glyph when every cell is taken. Glyphs looked up since glyphFrameStart are never evicted,
+// the software renderer reads their cells only after the whole frame has been laid out. ASCII glyphs
+// with an empty bitmap (e.g. space) or missing from the font only need their metrics, so they don't
+// take up a cell.
+bool RasterizeGlyph(FT_Face font, unsigned int codepoint, Character &character, bool pinned)
+{
+    if (FT_Load_Char(font, codepoint, FT_LOAD_RENDER))
+        return false;
+
+    FT_Bitmap &bitmap = font->glyph->bitmap;
+    character.TextureID = 0;
+    character.AtlasPage = 0;
+    character.Size = glm::ivec2(bitmap.width, bitmap.rows);
+    character.Bearing = glm::ivec2(font->glyph->bitmap_left, font->glyph->bitmap_top);
+    character.Advance = static_cast<unsigned int>(font->glyph->advance.x);
+    character.UVMin = glm::vec2(0.0f, 0.0f);
+    character.UVMax = glm::vec2(0.0f, 0.0f);
+
+    if (pinned && (bitmap.width == 0 || bitmap.rows == 0 || FT_Get_Char_Index(font, codepoint) == 0))
+        return true;
+
+    // pick a free cell, or the least recently used unpinned one
+    int cellIndex = -1;
+    for (int index = 0; index < MAX_GLYPH_CELLS; index++)
+    {
+        GlyphCell &candidate = glyphCells[index];
+        if (!candidate.InUse)
+        {
+            cellIndex = index;
+            break;
+        }
+        if (!candidate.Pinned && candidate.LastUsed <= glyphFrameStart && (cellIndex == -1 || candidate.LastUsed < glyphCells[cellIndex].LastUsed))
+            cellIndex = index;
+    }
+    if (cellIndex == -1)
+        return false;
+
+    GlyphCell &cell = glyphCells[cellIndex];
+    if (cell.InUse)
+        glyphCellIndex.erase(cell.Codepoint);
+
+    // copy the bitmap into a zeroed cell so nothing from the evicted glyph bleeds through filtering,
+    // clipping glyphs that don't fit (one texel is kept free as padding)
+    static unsigned char cellPixels[GLYPH_CELL_SIZE * GLYPH_CELL_SIZE];
+    int width = bitmap.width < GLYPH_CELL_SIZE - 1 ? bitmap.width : GLYPH_CELL_SIZE - 1;
+    int rows = bitmap.rows < GLYPH_CELL_SIZE - 1 ? bitmap.rows : GLYPH_CELL_SIZE - 1;
+    for (int i = 0; i < GLYPH_CELL_SIZE * GLYPH_CELL_SIZE; i++)
+    {
+        cellPixels[i] = 0;
+    }
+    for (int row = 0; row < rows; row++)
+    {
+        for (int column = 0; column < width; column++)
+        {
+            cellPixels[row * GLYPH_CELL_SIZE + column] = bitmap.buffer[row * bitmap.pitch + column];
+        }
+    }
+
+    int page = cellIndex / GLYPH_CELLS_PER_PAGE;
+    int cellX = (cellIndex % GLYPH_CELLS_PER_PAGE) % GLYPH_CELLS_PER_ROW * GLYPH_CELL_SIZE;
+    int cellY = (cellIndex % GLYPH_CELLS_PER_PAGE) / GLYPH_CELLS_PER_ROW * GLYPH_CELL_SIZE;
+    for (int row = 0; row < GLYPH_CELL_SIZE; row++)
+    {
+        memcpy(&atlasPagePixels[page][(cellY + row) * ATLAS_PAGE_SIZE + cellX], &cellPixels[row * GLYPH_CELL_SIZE], GLYPH_CELL_SIZE);
+    }
+#ifndef PONG_NO_GL
+    if (glyphAtlasOnGPU)
+    {
+        glBindTexture(GL_TEXTURE_2D, atlasPages[page]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, cellX, cellY, GLYPH_CELL_SIZE, GLYPH_CELL_SIZE, GL_RED, GL_UNSIGNED_BYTE, cellPixels);
+    }
+#endif
+
+    character.TextureID = atlasPages[page];
+    character.AtlasPage = page;
+    character.Size = glm::ivec2(width, rows);
+    character.UVMin = glm::vec2(cellX / static_cast<float>(ATLAS_PAGE_SIZE), cellY / static_cast<float>(ATLAS_PAGE_SIZE));
+    character.UVMax = glm::vec2((cellX + width) / static_cast<float>(ATLAS_PAGE_SIZE), (cellY + rows) / static_cast<float>(ATLAS_PAGE_SIZE));
+
+    cell.Codepoint = codepoint;
+    cell.InUse = true;
+    cell.Pinned = pinned;
+    cell.LastUsed = glyphUseCounter;
+    cell.Glyph = character;
+    if (!pinned)
+        glyphCellIndex[codepoint] = cellIndex;
+    return true;
+}
+
 void resetBall()
 {
     ballPositionX = 0.0f;
     ballPositionY = 0.0f;
-    ballVelocityX = (rand() % 2 == 0 ? 1 : -1) * 0.3f; // Randomize starting direction
+    ballVelocityX = (simulationRandom() % 2 == 0 ? 1 : -1) * 0.3f; // Randomize starting direction
     ballVelocityY = 0.0f;                              // Initial Y-axis speed of the ball
 }
 
-unsigned int compileShader(GLenum type, const char *source)
+// Paddle-angle response: reverse and speed up the ball, steering it by where it hit the paddle
+void bounceOffPaddle(float paddleYOffset, float positionY, float &velocityX, float &velocityY)
 {
-    unsigned int shader = glCreateShader(type);
-    glShaderSource(shader, 1, &source, NULL);
-    glCompileShader(shader);
-    // Check for compilation errors
-    int success;
-    char infoLog[512];
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    velocityX = -velocityX * SPEED_MULTIPLIER;
+    float relativeIntersectionY = (paddleYOffset - positionY) / (rectangleHeight / 2);
+    velocityY = relativeIntersectionY * 1.5f * SPEED_MULTIPLIER; // 1.5f determines the angle, adjust accordingly
+}
+
+void recordPaddleHit(float directionX)
+{
+    paddleHits++;
+    lastHitPositionX = ballPositionX;
+    lastHitPositionY = ballPositionY;
+    lastHitDirectionX = directionX;
+
+    rallyLength++;
+    metricsIncrement(COUNTER_PADDLE_HITS);
+    metricsSetGauge(GAUGE_RALLY_LENGTH, rallyLength);
+    metricsSetGauge(GAUGE_BALL_SPEED, std::sqrt(ballVelocityX * ballVelocityX + ballVelocityY * ballVelocityY));
+}
+
+void recordGoal()
+{
+    goals++;
+    lastGoalPositionX = ballPositionX;
+    lastGoalPositionY = ballPositionY;
+
+    rallyLength = 0;
+    metricsSetGauge(GAUGE_RALLY_LENGTH, rallyLength);
+}
+
+// Run the simulation at a fixed rate until the render loop stops it
+void simulationThread()
+{
+    pinCurrentThreadToCore(simulationThreadCore);
+
+    typedef std::chrono::steady_clock clock;
+    const clock::duration step = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(SIMULATION_STEP));
+    clock::time_point nextStep = clock::now();
+    double lastConsumedInputTime = lastKeyEventTime.load(std::memory_order_acquire);
+
+    while (simulationRunning.load(std::memory_order_relaxed))
     {
-        glGetShaderInfoLog(shader, 512, NULL, infoLog);
-        std::cout << "Shader compilation error:\n"
-                  << infoLog << std::endl;
-        return 0; // Return 0 to indicate failure
+        // input latency: time between GLFW delivering a key event and the simulation acting on it
+        double inputTime = lastKeyEventTime.load(std::memory_order_acquire);
+        if (inputTime != lastConsumedInputTime)
+        {
+            metricsObserve(HISTOGRAM_INPUT_LATENCY, getTime() - inputTime);
+            lastConsumedInputTime = inputTime;
+        }
+
+        stepSimulation(SIMULATION_STEP);
+        publishSnapshot();
+
+        // sleep until the next step; if the simulation fell too far behind (e.g. a huge stress
+        // mode step) drop the missed time instead of running a long burst of catch-up steps
+        nextStep += step;
+        clock::time_point now = clock::now();
+        if (now - nextStep > step * MAX_SIMULATION_CATCH_UP_STEPS)
+        {
+            nextStep = now;
+        }
+        std::this_thread::sleep_until(nextStep);
+        metricsObserve(HISTOGRAM_SIMULATION_JITTER, std::chrono::duration<double>(clock::now() - nextStep).count());
     }
-    return shader;
+}
+
+void stepSimulation(float deltaTime)
+{
+    // Input
+    processInput(deltaTime);
+
+    if (leftScore == MAX_SCORE || rightScore == MAX_SCORE)
+    {
+        if (!gameOver)
+        {
+            metricsIncrement(leftScore == MAX_SCORE ? COUNTER_MATCHES_WON_LEFT : COUNTER_MATCHES_WON_RIGHT);
+        }
+        gameOver = true;
+        isPlaying = false; // stop the game
+    }
+
+    if (isPlaying)
+    {
+        if (stressMode)
+        {
+            stepStressBalls(deltaTime);
+            metricsIncrement(COUNTER_SIMULATION_STEPS);
+            metricsSetGauge(GAUGE_STRESS_BALLS, stressBallCount);
+        }
+        else
+        {
+            // Ball movement
+            ballPositionX += ballVelocityX * deltaTime;
+            ballPositionY += ballVelocityY * deltaTime;
+            metricsIncrement(COUNTER_SIMULATION_STEPS);
+
+            // Wall collision
+            if (ballPositionY + ballSize >= 1.0f || ballPositionY - ballSize <= -1.0f)
+            {
+                ballVelocityY = -ballVelocityY;
+            }
+
+            // Paddle collision
+            if (ballPositionX - ballSize <= -0.8f && ballPositionY <= leftRectangleYOffset + 0.1f && ballPositionY >= leftRectangleYOffset - 0.1f)
+            {
+                bounceOffPaddle(leftRectangleYOffset, ballPositionY, ballVelocityX, ballVelocityY);
+                recordPaddleHit(1.0f);
+            }
+
+            else if (ballPositionX + ballSize >= 0.8f && ballPositionY <= rightRectangleYOffset + 0.1f && ballPositionY >= rightRectangleYOffset - 0.1f)
+            {
+                bounceOffPaddle(rightRectangleYOffset, ballPositionY, ballVelocityX, ballVelocityY);
+                recordPaddleHit(-1.0f);
+            }
+            // Reset ball if it goes past the left or right edges
+            if (ballPositionX - ballSize <= -1.0f || ballPositionX + ballSize >= 1.0f)
+            {
+                if (ballPositionX - ballSize <= -1.0f)
+                {
+                    rightScore++; // Increment right player's score when the ball passes the left edge
+                    metricsIncrement(COUNTER_GOALS_RIGHT);
+                }
+                if (ballPositionX + ballSize >= 1.0f)
+                {
+                    leftScore++; // Increment left player's score when the ball passes the right edge
+                    metricsIncrement(COUNTER_GOALS_LEFT);
+                }
+                recordGoal();
+                resetBall();
+            }
+        }
+    }
+}
+
+// Copy the simulation state into the back slot and make it the newest snapshot (simulation thread)
+void publishSnapshot()
+{
+    GameSnapshot &snapshot = snapshots[snapshotBack];
+    snapshot.LeftPaddleYOffset = leftRectangleYOffset;
+    snapshot.RightPaddleYOffset = rightRectangleYOffset;
+    snapshot.BallPositionX = ballPositionX;
+    snapshot.BallPositionY = ballPositionY;
+    snapshot.LeftScore = leftScore;
+    snapshot.RightScore = rightScore;
+    snapshot.IsPlaying = isPlaying;
+    snapshot.GameOver = gameOver;
+    snapshot.StressMode = stressMode;
+    snapshot.PaddleHits = paddleHits;
+    snapshot.LastHitPositionX = lastHitPositionX;
+    snapshot.LastHitPositionY = lastHitPositionY;
+    snapshot.LastHitDirectionX = lastHitDirectionX;
+    snapshot.Goals = goals;
+    snapshot.LastGoalPositionX = lastGoalPositionX;
+    snapshot.LastGoalPositionY = lastGoalPositionY;
+    snapshot.StressBallCount = stressMode ? stressBallCount : 0;
+    for (int i = 0; i < snapshot.StressBallCount; i++)
+    {
+        snapshot.StressBallPositionX[i] = stressBallPositionX[i];
+        snapshot.StressBallPositionY[i] = stressBallPositionY[i];
+    }
+
+    snapshotBack = snapshotMiddle.exchange(snapshotBack | SNAPSHOT_UPDATED, std::memory_order_acq_rel) & ~SNAPSHOT_UPDATED;
+}
+
+// Return the newest published snapshot, or the one from the previous frame if nothing new was published (render thread)
+const GameSnapshot &acquireSnapshot()
+{
+    if (snapshotMiddle.load(std::memory_order_relaxed) & SNAPSHOT_UPDATED)
+    {
+        snapshotFront = snapshotMiddle.exchange(snapshotFront, std::memory_order_acq_rel) & ~SNAPSHOT_UPDATED;
+    }
+    return snapshots[snapshotFront];
+}
+
+// Pin the calling thread to one core so the render and simulation threads don't migrate onto each
+// other. Only supported on Linux; elsewhere the scheduler decides.
+bool pinCurrentThreadToCore(int core)
+{
+#ifdef __linux__
+    if (core < 0 || core >= static_cast<int>(std::thread::hardware_concurrency()))
+        return false;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+    return false;
+#endif
+}
+
+// Thread pinning is opt-in: PONG_PIN_CORES=<render core>,<simulation core> (Linux only)
+void readThreadPinning()
+{
+    const char *cores = getenv("PONG_PIN_CORES");
+    if (!cores)
+        return;
+    if (sscanf(cores, "%d,%d", &renderThreadCore, &simulationThreadCore) != 2)
+    {
+        std::cout << "Ignoring PONG_PIN_CORES, expected <render core>,<simulation core>" << std::endl;
+        renderThreadCore = -1;
+        simulationThreadCore = -1;
+    }
+}
+
+void startStressMode(int ballCount)
+{
+    stressMode = true;
+    isPlaying = true;
+    stressBallCount = 0;
+    setStressBallCount(ballCount);
+    stressStepCount = 0;
+    stressStepTime = 0.0;
+    stressReportTime = getTime();
+}
+
+void setStressBallCount(int ballCount)
+{
+    if (ballCount < 1)
+        ballCount = 1;
+    if (ballCount > MAX_STRESS_BALLS)
+        ballCount = MAX_STRESS_BALLS;
+
+    for (int i = stressBallCount; i < ballCount; i++)
+    {
+        spawnStressBall(i);
+    }
+    stressBallCount = ballCount;
+}
+
+void spawnStressBall(int i)
+{
+    float angle = randomFloat(simulationRandom, 0.0f, 6.2831853f);
+    float speed = randomFloat(simulationRandom, 0.3f, 0.8f);
+    // Anywhere in the arena between the paddles
+    stressBallPositionX[i] = randomFloat(simulationRandom, -0.8f + stressBallSize, 0.8f - stressBallSize);
+    stressBallPositionY[i] = randomFloat(simulationRandom, -1.0f + stressBallSize, 1.0f - stressBallSize);
+    stressBallVelocityX[i] = std::cos(angle) * speed;
+    stressBallVelocityY[i] = std::sin(angle) * speed;
+}
+
+void stepStressBalls(float deltaTime)
+{
+    double stepStartTime = getTime();
+    const int count = stressBallCount;
+
+    // Ball movement
+    for (int i = 0; i < count; i++)
+    {
+        stressBallPositionX[i] += stressBallVelocityX[i] * deltaTime;
+        stressBallPositionY[i] += stressBallVelocityY[i] * deltaTime;
+    }
+
+    // Walls, paddles and edges
+    for (int i = 0; i < count; i++)
+    {
+        float x = stressBallPositionX[i];
+        float y = stressBallPositionY[i];
+
+        if ((y + stressBallSize >= 1.0f && stressBallVelocityY[i] > 0.0f) || (y - stressBallSize <= -1.0f && stressBallVelocityY[i] < 0.0f))
+        {
+            stressBallVelocityY[i] = -stressBallVelocityY[i];
+        }
+
+        // Unlike the single ball, only bounce balls still moving towards the paddle so a ball
+        // that overlaps it for several steps doesn't flip back and forth
+        if (x - stressBallSize <= -0.8f && stressBallVelocityX[i] < 0.0f && y <= leftRectangleYOffset + 0.1f && y >= leftRectangleYOffset - 0.1f)
+        {
+            bounceOffPaddle(leftRectangleYOffset, y, stressBallVelocityX[i], stressBallVelocityY[i]);
+        }
+        else if (x + stressBallSize >= 0.8f && stressBallVelocityX[i] > 0.0f && y <= rightRectangleYOffset + 0.1f && y >= rightRectangleYOffset - 0.1f)
+        {
+            bounceOffPaddle(rightRectangleYOffset, y, stressBallVelocityX[i], stressBallVelocityY[i]);
+        }
+
+        if (x - stressBallSize <= -1.0f || x + stressBallSize >= 1.0f)
+        {
+            spawnStressBall(i);
+        }
+    }
+
+    // Ball-vs-ball collisions: broadphase grid, then test each ball against its own cell and
+    // half of the neighbouring cells so that every pair is visited once
+    buildStressBallGrid();
+    for (int cellY = 0; cellY < STRESS_GRID_SIZE; cellY++)
+    {
+        for (int cellX = 0; cellX < STRESS_GRID_SIZE; cellX++)
+        {
+            int cell = cellY * STRESS_GRID_SIZE + cellX;
+            int cellEnd = stressGridCellStart[cell + 1];
+            for (int a = stressGridCellStart[cell]; a < cellEnd; a++)
+            {
+                int i = stressGridBalls[a];
+                for (int b = a + 1; b < cellEnd; b++)
+                {
+                    collideStressBalls(i, stressGridBalls[b]);
+                }
+
+                const int neighbourOffsets[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+                for (int n = 0; n < 4; n++)
+                {
+                    int neighbourX = cellX + neighbourOffsets[n][0];
+                    int neighbourY = cellY + neighbourOffsets[n][1];
+                    if (neighbourX < 0 || neighbourX >= STRESS_GRID_SIZE || neighbourY >= STRESS_GRID_SIZE)
+                        continue;
+                    int neighbour = neighbourY * STRESS_GRID_SIZE + neighbourX;
+                    for (int b = stressGridCellStart[neighbour]; b < stressGridCellStart[neighbour + 1]; b++)
+                    {
+                        collideStressBalls(i, stressGridBalls[b]);
+                    }
+                }
+            }
+        }
+    }
+
+    // Report steps/s as the ball count changes
+    double stepEndTime = getTime();
+    stressStepTime += stepEndTime - stepStartTime;
+    stressStepCount++;
+    if (stepEndTime - stressReportTime >= 1.0)
+    {
+        double averageStepTime = stressStepTime / stressStepCount;
+        std::cout << "Stress mode: " << stressBallCount << " balls, "
+                  << stressStepCount / (stepEndTime - stressReportTime) << " steps/s, "
+                  << averageStepTime * 1000.0 << " ms/step (" << 1.0 / averageStepTime << " steps/s simulation only)" << std::endl;
+        stressStepCount = 0;
+        stressStepTime = 0.0;
+        stressReportTime = stepEndTime;
+    }
+}
+
+// Counting sort of the balls into grid cells
+void buildStressBallGrid()
+{
+    const int count = stressBallCount;
+    for (int cell = 0; cell <= STRESS_GRID_CELLS; cell++)
+    {
+        stressGridCellStart[cell] = 0;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int cellX = static_cast<int>((stressBallPositionX[i] + 1.0f) * (STRESS_GRID_SIZE / 2.0f));
+        int cellY = static_cast<int>((stressBallPositionY[i] + 1.0f) * (STRESS_GRID_SIZE / 2.0f));
+        cellX = cellX < 0 ? 0 : (cellX >= STRESS_GRID_SIZE ? STRESS_GRID_SIZE - 1 : cellX);
+        cellY = cellY < 0 ? 0 : (cellY >= STRESS_GRID_SIZE ? STRESS_GRID_SIZE - 1 : cellY);
+        stressBallCell[i] = cellY * STRESS_GRID_SIZE + cellX;
+        stressGridCellStart[stressBallCell[i] + 1]++;
+    }
+
+    for (int cell = 0; cell < STRESS_GRID_CELLS; cell++)
+    {
+        stressGridCellStart[cell + 1] += stressGridCellStart[cell];
+    }
+
+    // stressBallCell is reused as the insertion cursor, leaving each cell's start intact
+    for (int i = 0; i < count; i++)
+    {
+        int cell = stressBallCell[i];
+        stressBallCell[i] = stressGridCellStart[cell]++;
+    }
+    for (int cell = STRESS_GRID_CELLS; cell > 0; cell--)
+    {
+        stressGridCellStart[cell] = stressGridCellStart[cell - 1];
+    }
+    stressGridCellStart[0] = 0;
+    for (int i = 0; i < count; i++)
+    {
+        stressGridBalls[stressBallCell[i]] = i;
+    }
+}
+
+// Elastic collision between two equally sized balls of equal mass
+void collideStressBalls(int i, int j)
+{
+    float deltaX = stressBallPositionX[j] - stressBallPositionX[i];
+    float deltaY = stressBallPositionY[j] - stressBallPositionY[i];
+    float distanceSquared = deltaX * deltaX + deltaY * deltaY;
+    const float minimumDistance = 2.0f * stressBallSize;
+    if (distanceSquared >= minimumDistance * minimumDistance || distanceSquared == 0.0f)
+        return;
+
+    float distance = std::sqrt(distanceSquared);
+    float normalX = deltaX / distance;
+    float normalY = deltaY / distance;
+
+    // Exchange the velocity components along the normal if the balls are approaching
+    float approachSpeed = (stressBallVelocityX[j] - stressBallVelocityX[i]) * normalX + (stressBallVelocityY[j] - stressBallVelocityY[i]) * normalY;
+    if (approachSpeed < 0.0f)
+    {
+        stressBallVelocityX[i] += approachSpeed * normalX;
+        stressBallVelocityY[i] += approachSpeed * normalY;
+        stressBallVelocityX[j] -= approachSpeed * normalX;
+        stressBallVelocityY[j] -= approachSpeed * normalY;
+    }
+
+    // Push the balls apart so they don't stay stuck together
+    float overlap = (minimumDistance - distance) * 0.5f;
+    stressBallPositionX[i] -= normalX * overlap;
+    stressBallPositionY[i] -= normalY * overlap;
+    stressBallPositionX[j] += normalX * overlap;
+    stressBallPositionY[j] += normalY * overlap;
+}
+
+#ifndef PONG_NO_GL
+void renderStressBalls(unsigned int shaderProgram, unsigned int VAO, unsigned int VBO, const GameSnapshot &snapshot)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * MAX_STRESS_BALLS * 2, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * snapshot.StressBallCount, snapshot.StressBallPositionX);
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * MAX_STRESS_BALLS, sizeof(float) * snapshot.StressBallCount, snapshot.StressBallPositionY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glUseProgram(shaderProgram);
+    glBindVertexArray(VAO);
+    // size, alpha and color are the same for every ball
+    glVertexAttrib1f(3, stressBallSize);
+    for (int i = 4; i <= 7; i++) // alpha, r, g, b
+    {
+        glVertexAttrib1f(i, 1.0f);
+    }
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, snapshot.StressBallCount);
+    glBindVertexArray(0);
+}
+#endif
+
+// Lay out the text for the current screen: the score while playing, otherwise the title or game over message
+int LayoutHud(const GameSnapshot &snapshot, HudText lines[2])
+{
+    if (snapshot.IsPlaying)
+    {
+        std::string scoreText = std::to_string(snapshot.LeftScore) + " - " + std::to_string(snapshot.RightScore); // Update the score text
+        if (snapshot.StressMode)
+        {
+            scoreText = "Balls: " + std::to_string(snapshot.StressBallCount);
+        }
+        float textWidth = CalculateTextWidth(scoreText, 1.0f); // Assuming a scale of 1.0
+        lines[0].Text = scoreText;
+        lines[0].X = (SCR_WIDTH - textWidth) / 2.0f;
+        lines[0].Y = SCR_HEIGHT - 70.0f; // 50 pixels from the top, adjust as necessary
+        lines[0].Scale = 1.0f;
+        return 1;
+    }
+
+    if (snapshot.GameOver)
+    {
+        std::string winner = snapshot.LeftScore == MAX_SCORE ? "Left Player" : "Right Player";
+        std::string winnerMessage = winner + " Wins!";
+        std::string restartMessage = "Press R to Restart.";
+
+        lines[0].Text = restartMessage;
+        lines[0].X = (SCR_WIDTH - CalculateTextWidth(restartMessage, 0.5f)) / 2.0f;
+        lines[0].Y = SCR_HEIGHT / 2.0f - 15.0f; // Adding half of the padding for the second line
+        lines[0].Scale = 0.5f;
+
+        lines[1].Text = winnerMessage;
+        lines[1].X = (SCR_WIDTH - CalculateTextWidth(winnerMessage, 0.5f)) / 2.0f;
+        lines[1].Y = SCR_HEIGHT / 2.0f + 15.0f; // Subtracting half of the padding for the first line
+        lines[1].Scale = 0.5f;
+        return 2;
+    }
+
+    std::string playMessage = "Press Enter to Play :)";
+    float textScale = 0.5f;                           // Adjust this value to change the size of the text
+    float textHeight = FONT_PIXEL_SIZE * textScale; // Adjust based on your font's characteristics
+    lines[0].Text = playMessage;
+    lines[0].X = (SCR_WIDTH - CalculateTextWidth(playMessage, textScale)) / 2.0f;
+    lines[0].Y = (SCR_HEIGHT - textHeight) / 2.0f;
+    lines[0].Scale = textScale;
+    return 1;
+}
+
+// Turn the paddle hits and goals published since the last frame into particles (render thread)
+void emitSnapshotParticles(const GameSnapshot &snapshot, unsigned int &seenPaddleHits, unsigned int &seenGoals)
+{
+    if (fillParticles)
+    {
+        fillParticlePool();
+    }
+    if (snapshot.IsPlaying && !snapshot.StressMode)
+    {
+        emitBallTrail(snapshot.BallPositionX, snapshot.BallPositionY);
+    }
+    for (; seenPaddleHits != snapshot.PaddleHits; seenPaddleHits++)
+    {
+        emitImpactBurst(snapshot.LastHitPositionX, snapshot.LastHitPositionY, snapshot.LastHitDirectionX);
+    }
+    for (; seenGoals != snapshot.Goals; seenGoals++)
+    {
+        emitGoalExplosion(snapshot.LastGoalPositionX, snapshot.LastGoalPositionY);
+    }
+}
+
+// Run the game with the CPU renderer instead of OpenGL. The headless and capture modes render
+// frameCount frames into memory, print the average frame time and optionally save the last frame as
+// a PPM image; the capture mode renders the capture scene instead of a running game (see
+// CAPTURE_FRAME_TIME). The window mode ignores frameCount.
+int runSoftwareRenderer(SoftwareRunMode mode, int frameCount, const char *imagePath)
+{
+    bool windowed = mode == SOFTWARE_RUN_WINDOW;
+    bool fixedScene = mode == SOFTWARE_RUN_CAPTURE;
+
+    // Everything that can fail comes before softwareRendererInit(), which starts the tile workers
+    if (!LoadFont())
+    {
+        return -1;
+    }
+
+    int width, height, nrChannels;
+    unsigned char *image = stbi_load("./images/background.jpeg", &width, &height, &nrChannels, 0);
+    if (!image)
+    {
+        std::cout << "Failed to open image: " << stbi_failure_reason() << std::endl;
+        return -1;
+    }
+
+    unsigned int threads = std::thread::hardware_concurrency();
+    bool initialized = softwareRendererInit(SCR_WIDTH, SCR_HEIGHT, image, width, height, nrChannels, threads ? threads : 1);
+    stbi_image_free(image);
+    if (!initialized)
+    {
+        return -1;
+    }
+
+    // In the window mode the render thread draws into a triple buffer of frames and the main thread
+    // presents the newest one, so neither X events nor the server's pace ever wait for rendering
+    std::vector<uint32_t> memoryFramebuffer(SCR_WIDTH * SCR_HEIGHT);
+    std::vector<uint32_t> windowFrames[3];
+    const int WINDOW_FRAME_UPDATED = 4; // Set in windowFrameMiddle when it holds a frame not presented yet
+    int windowFrameBack = 0;            // Only touched by the render thread
+    std::atomic<int> windowFrameMiddle(1);
+    int windowFrameFront = 2;           // Only touched by the main thread
+    if (windowed)
+    {
+        if (!softwareWindowOpen(SCR_WIDTH, SCR_HEIGHT, "Pong"))
+        {
+            softwareRendererShutdown();
+            return -1;
+        }
+        for (int i = 0; i < 3; i++)
+        {
+            windowFrames[i].resize(SCR_WIDTH * SCR_HEIGHT);
+        }
+    }
+    else
+    {
+        softwareRendererSetTarget(memoryFramebuffer.data(), SCR_WIDTH);
+        isPlaying = true; // measure the game scene rather than the title screen
+    }
+    if (fixedScene)
+    {
+        particleRandom.seed(CAPTURE_RANDOM_SEED);
+    }
+
+    if (startMetricsServer(METRICS_PORT))
+    {
+        std::cout << "Serving metrics on http://127.0.0.1:" << METRICS_PORT << "/metrics" << std::endl;
+    }
+
+    publishSnapshot();
+    const GameSnapshot *snapshot = &acquireSnapshot();
+
+    std::thread simulation;
+    if (!fixedScene)
+    {
+        simulationRunning.store(true);
+        simulation = std::thread(simulationThread);
+    }
+
+    int frames = 0;
+    double renderTime = 0.0;
+    std::atomic<bool> rendering(true);
+    auto renderFrames = [&]()
+    {
+        pinCurrentThreadToCore(renderThreadCore);
+
+        // Particle events already turned into effects
+        unsigned int seenPaddleHits = snapshot->PaddleHits;
+        unsigned int seenGoals = snapshot->Goals;
+
+        SoftwareScene scene;
+        double lastFrameTime = getTime();
+        double targetFrameTime = 1.0 / 60.0; // 60 FPS
+        while (windowed ? rendering.load() : frames < frameCount)
+        {
+            double currentFrameTime = getTime();
+            double deltaTime = fixedScene ? CAPTURE_FRAME_TIME : currentFrameTime - lastFrameTime;
+
+            snapshot = &acquireSnapshot();
+            emitSnapshotParticles(*snapshot, seenPaddleHits, seenGoals);
+            updateParticles(deltaTime);
+
+            BuildSoftwareScene(*snapshot, scene);
+            if (windowed)
+            {
+                softwareRendererSetTarget(windowFrames[windowFrameBack].data(), SCR_WIDTH);
+            }
+            softwareRenderFrame(scene);
+            renderTime += getTime() - currentFrameTime;
+            frames++;
+
+            if (windowed)
+            {
+                // hand the frame to the main thread and wake it up to present it
+                windowFrameBack = windowFrameMiddle.exchange(windowFrameBack | WINDOW_FRAME_UPDATED, std::memory_order_acq_rel) & ~WINDOW_FRAME_UPDATED;
+                softwareWindowPostEmptyEvent();
+            }
+
+            double frameDuration = getTime() - currentFrameTime;
+            metricsIncrement(COUNTER_FRAMES);
+            metricsObserve(HISTOGRAM_FRAME_TIME, deltaTime);
+            metricsSetGauge(GAUGE_PARTICLES, particleCount);
+            if (frameDuration > targetFrameTime)
+            {
+                metricsIncrement(COUNTER_LATE_FRAMES);
+            }
+
+            if (windowed && frameDuration < targetFrameTime)
+            {
+                std::this_thread::sleep_for(std::chrono::duration<double>(targetFrameTime - frameDuration));
+            }
+            lastFrameTime = currentFrameTime;
+        }
+    };
+
+    if (windowed)
+    {
+        std::thread render(renderFrames);
+
+        // event loop: the main thread only reads X events, handing keys to the simulation, and
+        // presents finished frames once the server has read the previous one
+        while (softwareWindowWaitEvents(software_key_callback) && !keyStates[KEY_ESCAPE].load())
+        {
+            if ((windowFrameMiddle.load(std::memory_order_relaxed) & WINDOW_FRAME_UPDATED) && softwareWindowReady())
+            {
+                windowFrameFront = windowFrameMiddle.exchange(windowFrameFront, std::memory_order_acq_rel) & ~WINDOW_FRAME_UPDATED;
+                softwareWindowPresent(windowFrames[windowFrameFront].data());
+            }
+        }
+
+        rendering.store(false);
+        render.join();
+    }
+    else
+    {
+        renderFrames();
+    }
+
+    if (simulation.joinable())
+    {
+        simulationRunning.store(false);
+        simulation.join();
+    }
+
+    if (frames > 0)
+    {
+        std::cout << "Software renderer: " << frames << " frames, " << renderTime / frames * 1000.0 << " ms/frame (scene + rasterization)" << std::endl;
+    }
+    if (imagePath && !windowed && !WriteImage(imagePath, memoryFramebuffer.data(), SCR_WIDTH, SCR_HEIGHT))
+    {
+        std::cout << "Failed to write image: " << imagePath << std::endl;
+    }
+
+    softwareWindowClose();
+    softwareRendererShutdown();
+    FT_Done_Face(face);
+    FT_Done_FreeType(ft);
+    stopMetricsServer();
+    return 0;
+}
+
+// Pixel rectangle covering the pixels whose centers are inside an NDC box, like the GL rasterizer
+SoftwareRect ndcRect(float left, float bottom, float right, float top, uint32_t color)
+{
+    SoftwareRect rect;
+    rect.X0 = static_cast<int>(std::ceil((left + 1.0f) * 0.5f * SCR_WIDTH - 0.5f));
+    rect.X1 = static_cast<int>(std::ceil((right + 1.0f) * 0.5f * SCR_WIDTH - 0.5f));
+    rect.Y0 = static_cast<int>(std::ceil((1.0f - top) * 0.5f * SCR_HEIGHT - 0.5f));
+    rect.Y1 = static_cast<int>(std::ceil((1.0f - bottom) * 0.5f * SCR_HEIGHT - 0.5f));
+    rect.Color = color;
+    return rect;
+}
+
+// Describe the same scene the GL render loop draws
+void BuildSoftwareScene(const GameSnapshot &snapshot, SoftwareScene &scene)
+{
+    const uint32_t white = 0xFFFFFFFFu;
+    scene.clear();
+
+    // particles, blended additively like GL_SRC_ALPHA, GL_ONE
+    for (int i = 0; i < particleCount; i++)
+    {
+        float alpha = particleAlpha[i] * 255.0f;
+        uint32_t red = static_cast<uint32_t>(particleColorR[i] * alpha + 0.5f);
+        uint32_t green = static_cast<uint32_t>(particleColorG[i] * alpha + 0.5f);
+        uint32_t blue = static_cast<uint32_t>(particleColorB[i] * alpha + 0.5f);
+        scene.AdditiveRects.push_back(ndcRect(particlePositionX[i] - particleSize[i], particlePositionY[i] - particleSize[i],
+                                              particlePositionX[i] + particleSize[i], particlePositionY[i] + particleSize[i],
+                                              (red << 16) | (green << 8) | blue));
+    }
+
+    if (snapshot.IsPlaying)
+    {
+        scene.Rects.push_back(ndcRect(-0.85f, snapshot.LeftPaddleYOffset - rectangleHeight / 2, -0.8f, snapshot.LeftPaddleYOffset + rectangleHeight / 2, white));
+        scene.Rects.push_back(ndcRect(0.8f, snapshot.RightPaddleYOffset - rectangleHeight / 2, 0.85f, snapshot.RightPaddleYOffset + rectangleHeight / 2, white));
+        if (snapshot.StressMode)
+        {
+            for (int i = 0; i < snapshot.StressBallCount; i++)
+            {
+                scene.Rects.push_back(ndcRect(snapshot.StressBallPositionX[i] - stressBallSize, snapshot.StressBallPositionY[i] - stressBallSize,
+                                              snapshot.StressBallPositionX[i] + stressBallSize, snapshot.StressBallPositionY[i] + stressBallSize, white));
+            }
+        }
+        else
+        {
+            scene.Rects.push_back(ndcRect(snapshot.BallPositionX - ballSize, snapshot.BallPositionY - ballSize,
+                                          snapshot.BallPositionX + ballSize, snapshot.BallPositionY + ballSize, white));
+        }
+    }
+
+    // text, positioned the same way as RenderText() (y up from the bottom of the window)
+    glyphFrameStart = glyphUseCounter;
+    HudText hudLines[2];
+    int hudLineCount = LayoutHud(snapshot, hudLines);
+    for (int line = 0; line < hudLineCount; line++)
+    {
+        float x = hudLines[line].X;
+        float scale = hudLines[line].Scale;
+        size_t i = 0;
+        while (i < hudLines[line].Text.size())
+        {
+            const Character &ch = GetCharacter(DecodeUTF8(hudLines[line].Text, i));
+            float xpos = x + ch.Bearing.x * scale;
+            float ypos = hudLines[line].Y - (ch.Size.y - ch.Bearing.y) * scale;
+            float w = ch.Size.x * scale;
+            float h = ch.Size.y * scale;
+            x += (ch.Advance >> 6) * scale;
+            if (ch.Size.x == 0 || ch.Size.y == 0)
+                continue;
+
+            SoftwareGlyph glyph;
+            glyph.X0 = xpos;
+            glyph.X1 = xpos + w;
+            glyph.Y0 = SCR_HEIGHT - (ypos + h);
+            glyph.Y1 = SCR_HEIGHT - ypos;
+            glyph.U0 = ch.UVMin.x;
+            glyph.V0 = ch.UVMin.y;
+            glyph.U1 = ch.UVMax.x;
+            glyph.V1 = ch.UVMax.y;
+            glyph.Page = atlasPagePixels[ch.AtlasPage];
+            glyph.PageSize = ATLAS_PAGE_SIZE;
+            glyph.Color = white;
+            scene.Glyphs.push_back(glyph);
+        }
+    }
+}
+
+// Save pixels as a binary PPM image
+bool WriteImage(const char *path, const uint32_t *pixels, int width, int height)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    file << "P6\n"
+         << width << " " << height << "\n255\n";
+    for (int i = 0; i < width * height; i++)
+    {
+        char rgb[3] = {static_cast<char>(pixels[i] >> 16), static_cast<char>(pixels[i] >> 8), static_cast<char>(pixels[i])};
+        file.write(rgb, 3);
+    }
+    return static_cast<bool>(file);
+}
+
+// Load a binary PPM image as written by WriteImage
+bool ReadImage(const char *path, std::vector<unsigned char> &rgb, int &width, int &height)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string magic;
+    int maxValue;
+    if (!(file >> magic >> width >> height >> maxValue) || magic != "P6" || maxValue != 255 || width <= 0 || height <= 0)
+        return false;
+    file.get(); // single whitespace before the pixels
+    rgb.resize(static_cast<size_t>(width) * height * 3);
+    file.read(reinterpret_cast<char *>(rgb.data()), rgb.size());
+    return static_cast<bool>(file);
+}
+
+// Compare two captures, printing how far apart they are; returns 0 when they are within tolerance
+int compareCaptures(const char *firstPath, const char *secondPath)
+{
+    std::vector<unsigned char> first, second;
+    int firstWidth, firstHeight, secondWidth, secondHeight;
+    if (!ReadImage(firstPath, first, firstWidth, firstHeight) || !ReadImage(secondPath, second, secondWidth, secondHeight))
+    {
+        std::cout << "Failed to read the images" << std::endl;
+        return -1;
+    }
+    if (firstWidth != secondWidth || firstHeight != secondHeight)
+    {
+        std::cout << "Image sizes differ: " << firstWidth << "x" << firstHeight << " and " << secondWidth << "x" << secondHeight << std::endl;
+        return 1;
+    }
+
+    int pixels = firstWidth * firstHeight;
+    int differentPixels = 0;
+    int maxDifference = 0;
+    for (int i = 0; i < pixels; i++)
+    {
+        int pixelDifference = 0;
+        for (int channel = 0; channel < 3; channel++)
+        {
+            int difference = std::abs(first[i * 3 + channel] - second[i * 3 + channel]);
+            pixelDifference = difference > pixelDifference ? difference : pixelDifference;
+        }
+        maxDifference = pixelDifference > maxDifference ? pixelDifference : maxDifference;
+        if (pixelDifference > CAPTURE_CHANNEL_TOLERANCE)
+            differentPixels++;
+    }
+
+    double differentFraction = differentPixels / static_cast<double>(pixels);
+    bool passed = differentFraction <= CAPTURE_MAX_DIFFERENT_PIXELS;
+    std::cout << differentPixels << " pixels (" << differentFraction * 100.0 << "%) differ by more than " << CAPTURE_CHANNEL_TOLERANCE
+              << ", largest difference " << maxDifference << ", limit " << CAPTURE_MAX_DIFFERENT_PIXELS * 100.0 << "%: "
+              << (passed ? "PASS" : "FAIL") << std::endl;
+    return passed ? 0 : 1;
+}
+
+#ifndef PONG_NO_GL
+unsigned int compileShader(GLenum type, const char *source)
+{
+    unsigned int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    // Check for compilation errors
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cout << "Shader compilation error:\n"
+                  << infoLog << std::endl;
+        return 0; // Return 0 to indicate failure
+    }
+    return shader;
+}
+#endif
+
+// Advance every live particle, then compact the pool by swapping dead particles with the last live one
+void updateParticles(float deltaTime)
+{
+    const int count = particleCount;
+    const float damping = deltaTime < 1.0f / PARTICLE_DRAG ? 1.0f - PARTICLE_DRAG * deltaTime : 0.0f;
+
+    // Move, slow down and fade every particle with the widest SIMD kernel the CPU supports
+    static void (*updateParticleKernel)(int count, float deltaTime, float damping) = selectParticleKernel();
+    updateParticleKernel(count, deltaTime, damping);
+
+    int i = 0;
+    while (i < particleCount)
+    {
+        if (particleLife[i] > 0.0f)
+        {
+            i++;
+            continue;
+        }
+        int last = --particleCount;
+        particlePositionX[i] = particlePositionX[last];
+        particlePositionY[i] = particlePositionY[last];
+        particleVelocityX[i] = particleVelocityX[last];
+        particleVelocityY[i] = particleVelocityY[last];
+        particleLife[i] = particleLife[last];
+        particleInverseLifetime[i] = particleInverseLifetime[last];
+        particleSize[i] = particleSize[last];
+        particleAlpha[i] = particleAlpha[last];
+        particleColorR[i] = particleColorR[last];
+        particleColorG[i] = particleColorG[last];
+        particleColorB[i] = particleColorB[last];
+    }
+}
+
+// Particle update kernels: move by the velocity, apply drag and fade out with the remaining lifetime.
+// The SIMD versions handle whole vectors from index 0 (the arrays are 32-byte aligned) and leave the
+// tail to the scalar one.
+void updateParticlesScalar(int first, int count, float deltaTime, float damping)
+{
+    for (int i = first; i < count; i++)
+    {
+        particlePositionX[i] += particleVelocityX[i] * deltaTime;
+        particlePositionY[i] += particleVelocityY[i] * deltaTime;
+        particleVelocityX[i] *= damping;
+        particleVelocityY[i] *= damping;
+        particleLife[i] -= deltaTime;
+        float fade = particleLife[i] * particleInverseLifetime[i];
+        particleAlpha[i] = fade > 0.0f ? fade : 0.0f;
+    }
+}
+
+void updateParticlesPortable(int count, float deltaTime, float damping)
+{
+    updateParticlesScalar(0, count, deltaTime, damping);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2"))) void updateParticlesSSE2(int count, float deltaTime, float damping)
+{
+    const __m128 dt = _mm_set1_ps(deltaTime);
+    const __m128 drag = _mm_set1_ps(damping);
+    const __m128 zero = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 velocityX = _mm_load_ps(particleVelocityX + i);
+        __m128 velocityY = _mm_load_ps(particleVelocityY + i);
+        _mm_store_ps(particlePositionX + i, _mm_add_ps(_mm_load_ps(particlePositionX + i), _mm_mul_ps(velocityX, dt)));
+        _mm_store_ps(particlePositionY + i, _mm_add_ps(_mm_load_ps(particlePositionY + i), _mm_mul_ps(velocityY, dt)));
+        _mm_store_ps(particleVelocityX + i, _mm_mul_ps(velocityX, drag));
+        _mm_store_ps(particleVelocityY + i, _mm_mul_ps(velocityY, drag));
+        __m128 life = _mm_sub_ps(_mm_load_ps(particleLife + i), dt);
+        _mm_store_ps(particleLife + i, life);
+        _mm_store_ps(particleAlpha + i, _mm_max_ps(_mm_mul_ps(life, _mm_load_ps(particleInverseLifetime + i)), zero));
+    }
+    updateParticlesScalar(i, count, deltaTime, damping);
+}
+
+__attribute__((target("avx2"))) void updateParticlesAVX2(int count, float deltaTime, float damping)
+{
+    const __m256 dt = _mm256_set1_ps(deltaTime);
+    const __m256 drag = _mm256_set1_ps(damping);
+    const __m256 zero = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 velocityX = _mm256_load_ps(particleVelocityX + i);
+        __m256 velocityY = _mm256_load_ps(particleVelocityY + i);
+        _mm256_store_ps(particlePositionX + i, _mm256_add_ps(_mm256_load_ps(particlePositionX + i), _mm256_mul_ps(velocityX, dt)));
+        _mm256_store_ps(particlePositionY + i, _mm256_add_ps(_mm256_load_ps(particlePositionY + i), _mm256_mul_ps(velocityY, dt)));
+        _mm256_store_ps(particleVelocityX + i, _mm256_mul_ps(velocityX, drag));
+        _mm256_store_ps(particleVelocityY + i, _mm256_mul_ps(velocityY, drag));
+        __m256 life = _mm256_sub_ps(_mm256_load_ps(particleLife + i), dt);
+        _mm256_store_ps(particleLife + i, life);
+        _mm256_store_ps(particleAlpha + i, _mm256_max_ps(_mm256_mul_ps(life, _mm256_load_ps(particleInverseLifetime + i)), zero));
+    }
+    updateParticlesScalar(i, count, deltaTime, damping);
+}
+#elif defined(__ARM_NEON)
+void updateParticlesNEON(int count, float deltaTime, float damping)
+{
+    const float32x4_t dt = vdupq_n_f32(deltaTime);
+    const float32x4_t drag = vdupq_n_f32(damping);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t velocityX = vld1q_f32(particleVelocityX + i);
+        float32x4_t velocityY = vld1q_f32(particleVelocityY + i);
+        vst1q_f32(particlePositionX + i, vaddq_f32(vld1q_f32(particlePositionX + i), vmulq_f32(velocityX, dt)));
+        vst1q_f32(particlePositionY + i, vaddq_f32(vld1q_f32(particlePositionY + i), vmulq_f32(velocityY, dt)));
+        vst1q_f32(particleVelocityX + i, vmulq_f32(velocityX, drag));
+        vst1q_f32(particleVelocityY + i, vmulq_f32(velocityY, drag));
+        float32x4_t life = vsubq_f32(vld1q_f32(particleLife + i), dt);
+        vst1q_f32(particleLife + i, life);
+        vst1q_f32(particleAlpha + i, vmaxq_f32(vmulq_f32(life, vld1q_f32(particleInverseLifetime + i)), zero));
+    }
+    updateParticlesScalar(i, count, deltaTime, damping);
+}
+#endif
+
+// Pick the particle update kernel for this CPU, AVX2 is checked at runtime since SSE2 is the x86 baseline
+void (*selectParticleKernel())(int count, float deltaTime, float damping)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2"))
+        return updateParticlesAVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return updateParticlesSSE2;
+#elif defined(__ARM_NEON)
+    return updateParticlesNEON;
+#endif
+    return updateParticlesPortable;
+}
+
+#ifndef PONG_NO_GL
+// Upload the live range of each SoA array and draw all particles with a single instanced call
+void renderParticles(unsigned int shaderProgram, unsigned int VAO, unsigned int VBO)
+{
+    if (particleCount == 0)
+        return;
+
+    const float *attributes[PARTICLE_ATTRIBUTES] = {
+        particlePositionX, particlePositionY, particleSize, particleAlpha,
+        particleColorR, particleColorG, particleColorB};
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    // orphan the previous frame's storage so the driver doesn't stall on a buffer still in use
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * MAX_PARTICLES * PARTICLE_ATTRIBUTES, NULL, GL_STREAM_DRAW);
+    for (int i = 0; i < PARTICLE_ATTRIBUTES; i++)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * MAX_PARTICLES * i, sizeof(float) * particleCount, attributes[i]);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glUseProgram(shaderProgram);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE); // additive blending so overlapping particles glow
+    glBindVertexArray(VAO);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 6, particleCount);
+    glBindVertexArray(0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+// Read the bound framebuffer back and save it with WriteImage(), so GL and software frames can be compared
+bool CaptureFramebuffer(const char *path, int width, int height)
+{
+    std::vector<unsigned char> rgba(width * height * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+
+    // GL rows start at the bottom of the screen, WriteImage() rows at the top
+    std::vector<uint32_t> pixels(width * height);
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char *row = &rgba[(height - 1 - y) * width * 4];
+        for (int x = 0; x < width; x++)
+        {
+            pixels[y * width + x] = 0xFF000000u | (row[x * 4] << 16) | (row[x * 4 + 1] << 8) | row[x * 4 + 2];
+        }
+    }
+    return WriteImage(path, pixels.data(), width, height);
+}
+#endif
+
+// Add a particle to the pool; silently dropped when the pool is full
+void emitParticle(float x, float y, float velocityX, float velocityY, float lifetime, float size, glm::vec3 color)
+{
+    if (particleCount >= MAX_PARTICLES)
+        return;
+
+    int i = particleCount++;
+    particlePositionX[i] = x;
+    particlePositionY[i] = y;
+    particleVelocityX[i] = velocityX;
+    particleVelocityY[i] = velocityY;
+    particleLife[i] = lifetime;
+    particleInverseLifetime[i] = 1.0f / lifetime;
+    particleSize[i] = size;
+    particleAlpha[i] = 1.0f;
+    particleColorR[i] = color.x;
+    particleColorG[i] = color.y;
+    particleColorB[i] = color.z;
+}
+
+void emitBallTrail(float x, float y)
+{
+    for (int i = 0; i < TRAIL_PARTICLES_PER_FRAME; i++)
+    {
+        emitParticle(x + randomFloat(particleRandom, -ballSize, ballSize), y + randomFloat(particleRandom, -ballSize, ballSize),
+                     randomFloat(particleRandom, -0.05f, 0.05f), randomFloat(particleRandom, -0.05f, 0.05f),
+                     randomFloat(particleRandom, 0.2f, 0.4f), ballSize * 0.3f, glm::vec3(0.4f, 0.7f, 1.0f));
+    }
+}
+
+// directionX is the side the ball bounces towards (1 for the left paddle, -1 for the right one)
+void emitImpactBurst(float x, float y, float directionX)
+{
+    for (int i = 0; i < IMPACT_PARTICLES; i++)
+    {
+        emitParticle(x, y,
+                     directionX * randomFloat(particleRandom, 0.2f, 1.2f), randomFloat(particleRandom, -1.0f, 1.0f),
+                     randomFloat(particleRandom, 0.2f, 0.6f), randomFloat(particleRandom, 0.003f, 0.008f), glm::vec3(1.0f, 0.8f, 0.3f));
+    }
+}
+
+void emitGoalExplosion(float x, float y)
+{
+    for (int i = 0; i < GOAL_PARTICLES; i++)
+    {
+        float angle = randomFloat(particleRandom, 0.0f, 6.2831853f);
+        float speed = randomFloat(particleRandom, 0.1f, 2.0f);
+        emitParticle(x, y,
+                     std::cos(angle) * speed, std::sin(angle) * speed,
+                     randomFloat(particleRandom, 0.5f, 1.5f), randomFloat(particleRandom, 0.004f, 0.012f), glm::vec3(1.0f, randomFloat(particleRandom, 0.2f, 0.6f), 0.1f));
+    }
+}
+
+// Top the pool up to MAX_PARTICLES with sparks spread over the whole screen
+void fillParticlePool()
+{
+    while (particleCount < MAX_PARTICLES)
+    {
+        emitParticle(randomFloat(particleRandom, -1.0f, 1.0f), randomFloat(particleRandom, -1.0f, 1.0f),
+                     randomFloat(particleRandom, -0.3f, 0.3f), randomFloat(particleRandom, -0.3f, 0.3f),
+                     randomFloat(particleRandom, 0.5f, 2.0f), randomFloat(particleRandom, 0.003f, 0.008f), glm::vec3(randomFloat(particleRandom, 0.2f, 1.0f), randomFloat(particleRandom, 0.2f, 1.0f), 1.0f));
+    }
+}
+
+// Each thread passes its own generator, std::minstd_rand isn't safe to share between threads
+float randomFloat(std::minstd_rand &generator, float min, float max)
+{
+    return min + (max - min) * ((generator() - generator.min()) / static_cast<float>(generator.max() - generator.min()));
 }
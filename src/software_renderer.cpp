@@ -0,0 +1,695 @@
+#include "software_renderer.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SOFTWARE_RENDERER_AVX2
+#endif
+
+const int TILE_SIZE = 64;
+
+static int frameWidth = 0;
+static int frameHeight = 0;
+static int tilesX = 0;
+static int tilesY = 0;
+static uint32_t *framePixels = nullptr;
+static int frameStride = 0;
+static std::vector<uint32_t> resampledBackground; // frameWidth x frameHeight
+
+// Per-tile lists of rectangle indices, rebuilt every frame with a counting sort
+static std::vector<int> additiveTileStart;
+static std::vector<int> additiveTileRects;
+static std::vector<int> opaqueTileStart;
+static std::vector<int> opaqueTileRects;
+
+// Tile workers: every frame the render thread bumps frameGeneration, then it and the workers take
+// tiles from nextTile until none are left
+static std::vector<std::thread> tileWorkers;
+static std::mutex tileMutex;
+static std::condition_variable tileFrameStart;
+static std::condition_variable tileFrameDone;
+static unsigned int frameGeneration = 0;
+static size_t tileWorkersDone = 0;
+static bool tileWorkersStopping = false;
+static std::atomic<int> nextTile(0);
+static const SoftwareScene *currentScene = nullptr;
+
+// Span kernels, AVX2 versions are picked at init when the CPU supports them
+static void fillSpanScalar(uint32_t *pixels, int count, uint32_t color)
+{
+    for (int i = 0; i < count; i++)
+    {
+        pixels[i] = color;
+    }
+}
+
+static void addSpanScalar(uint32_t *pixels, int count, uint32_t color)
+{
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t result = 0;
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            uint32_t sum = ((pixels[i] >> shift) & 0xFF) + ((color >> shift) & 0xFF);
+            result |= (sum > 0xFF ? 0xFF : sum) << shift;
+        }
+        pixels[i] = result;
+    }
+}
+
+#ifdef SOFTWARE_RENDERER_AVX2
+__attribute__((target("avx2"))) static void fillSpanAVX2(uint32_t *pixels, int count, uint32_t color)
+{
+    __m256i colors = _mm256_set1_epi32(static_cast<int>(color));
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(pixels + i), colors);
+    }
+    fillSpanScalar(pixels + i, count - i, color);
+}
+
+// Saturating per-channel add, 8 pixels at a time
+__attribute__((target("avx2"))) static void addSpanAVX2(uint32_t *pixels, int count, uint32_t color)
+{
+    __m256i colors = _mm256_set1_epi32(static_cast<int>(color));
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i *destination = reinterpret_cast<__m256i *>(pixels + i);
+        _mm256_storeu_si256(destination, _mm256_adds_epu8(_mm256_loadu_si256(destination), colors));
+    }
+    addSpanScalar(pixels + i, count - i, color);
+}
+#endif
+
+static void (*fillSpan)(uint32_t *pixels, int count, uint32_t color) = fillSpanScalar;
+static void (*addSpan)(uint32_t *pixels, int count, uint32_t color) = addSpanScalar;
+
+// Bucket rectangle indices by the tiles they overlap, keeping their original order within a tile
+static void binRects(const std::vector<SoftwareRect> &rects, std::vector<int> &tileStart, std::vector<int> &tileRects)
+{
+    const int tileCount = tilesX * tilesY;
+    tileStart.assign(tileCount + 1, 0);
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (size_t i = 0; i < rects.size(); i++)
+        {
+            const SoftwareRect &rect = rects[i];
+            if (rect.X0 >= rect.X1 || rect.Y0 >= rect.Y1 || rect.X1 <= 0 || rect.Y1 <= 0 || rect.X0 >= frameWidth || rect.Y0 >= frameHeight)
+                continue;
+            int firstTileX = rect.X0 > 0 ? rect.X0 / TILE_SIZE : 0;
+            int firstTileY = rect.Y0 > 0 ? rect.Y0 / TILE_SIZE : 0;
+            int lastTileX = (rect.X1 < frameWidth ? rect.X1 - 1 : frameWidth - 1) / TILE_SIZE;
+            int lastTileY = (rect.Y1 < frameHeight ? rect.Y1 - 1 : frameHeight - 1) / TILE_SIZE;
+            for (int tileY = firstTileY; tileY <= lastTileY; tileY++)
+            {
+                for (int tileX = firstTileX; tileX <= lastTileX; tileX++)
+                {
+                    int tile = tileY * tilesX + tileX;
+                    if (pass == 0)
+                        tileStart[tile + 1]++;
+                    else
+                        tileRects[tileStart[tile]++] = static_cast<int>(i);
+                }
+            }
+        }
+
+        if (pass == 0)
+        {
+            for (int tile = 0; tile < tileCount; tile++)
+            {
+                tileStart[tile + 1] += tileStart[tile];
+            }
+            tileRects.resize(tileStart[tileCount]);
+        }
+        else
+        {
+            // the fill pass advanced each start to the next tile's start, shift them back
+            for (int tile = tileCount; tile > 0; tile--)
+            {
+                tileStart[tile] = tileStart[tile - 1];
+            }
+            tileStart[0] = 0;
+        }
+    }
+}
+
+static void drawRects(const std::vector<SoftwareRect> &rects, const int *indices, int count, int tileX0, int tileY0, int tileX1, int tileY1,
+                      void (*span)(uint32_t *, int, uint32_t))
+{
+    for (int i = 0; i < count; i++)
+    {
+        const SoftwareRect &rect = rects[indices[i]];
+        int x0 = rect.X0 > tileX0 ? rect.X0 : tileX0;
+        int x1 = rect.X1 < tileX1 ? rect.X1 : tileX1;
+        int y0 = rect.Y0 > tileY0 ? rect.Y0 : tileY0;
+        int y1 = rect.Y1 < tileY1 ? rect.Y1 : tileY1;
+        for (int y = y0; y < y1; y++)
+        {
+            span(framePixels + y * frameStride + x0, x1 - x0, rect.Color);
+        }
+    }
+}
+
+// Bilinearly sample the atlas at texel coordinates (x, y), clamping at the page edges
+static float sampleAtlas(const unsigned char *page, int size, float x, float y)
+{
+    x -= 0.5f;
+    y -= 0.5f;
+    int x0 = static_cast<int>(std::floor(x));
+    int y0 = static_cast<int>(std::floor(y));
+    float fractionX = x - x0;
+    float fractionY = y - y0;
+    int x1 = x0 + 1 < size ? x0 + 1 : size - 1;
+    int y1 = y0 + 1 < size ? y0 + 1 : size - 1;
+    x0 = x0 < 0 ? 0 : x0;
+    y0 = y0 < 0 ? 0 : y0;
+    float top = page[y0 * size + x0] + (page[y0 * size + x1] - page[y0 * size + x0]) * fractionX;
+    float bottom = page[y1 * size + x0] + (page[y1 * size + x1] - page[y1 * size + x0]) * fractionX;
+    return top + (bottom - top) * fractionY;
+}
+
+static void drawGlyph(const SoftwareGlyph &glyph, int tileX0, int tileY0, int tileX1, int tileY1)
+{
+    // pixels whose centers fall inside the quad, like the GL rasterizer
+    int x0 = static_cast<int>(std::ceil(glyph.X0 - 0.5f));
+    int x1 = static_cast<int>(std::ceil(glyph.X1 - 0.5f));
+    int y0 = static_cast<int>(std::ceil(glyph.Y0 - 0.5f));
+    int y1 = static_cast<int>(std::ceil(glyph.Y1 - 0.5f));
+    x0 = x0 > tileX0 ? x0 : tileX0;
+    x1 = x1 < tileX1 ? x1 : tileX1;
+    y0 = y0 > tileY0 ? y0 : tileY0;
+    y1 = y1 < tileY1 ? y1 : tileY1;
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    const float texelsPerPixelX = (glyph.U1 - glyph.U0) * glyph.PageSize / (glyph.X1 - glyph.X0);
+    const float texelsPerPixelY = (glyph.V1 - glyph.V0) * glyph.PageSize / (glyph.Y1 - glyph.Y0);
+    const int red = (glyph.Color >> 16) & 0xFF;
+    const int green = (glyph.Color >> 8) & 0xFF;
+    const int blue = glyph.Color & 0xFF;
+
+    for (int y = y0; y < y1; y++)
+    {
+        float texelY = glyph.V0 * glyph.PageSize + (y + 0.5f - glyph.Y0) * texelsPerPixelY;
+        uint32_t *row = framePixels + y * frameStride;
+        for (int x = x0; x < x1; x++)
+        {
+            float texelX = glyph.U0 * glyph.PageSize + (x + 0.5f - glyph.X0) * texelsPerPixelX;
+            int alpha = static_cast<int>(sampleAtlas(glyph.Page, glyph.PageSize, texelX, texelY) + 0.5f);
+            if (alpha == 0)
+                continue;
+
+            uint32_t destination = row[x];
+            int destinationRed = (destination >> 16) & 0xFF;
+            int destinationGreen = (destination >> 8) & 0xFF;
+            int destinationBlue = destination & 0xFF;
+            destinationRed += ((red - destinationRed) * alpha + 127) / 255;
+            destinationGreen += ((green - destinationGreen) * alpha + 127) / 255;
+            destinationBlue += ((blue - destinationBlue) * alpha + 127) / 255;
+            row[x] = 0xFF000000u | (destinationRed << 16) | (destinationGreen << 8) | destinationBlue;
+        }
+    }
+}
+
+static void renderTile(int tile)
+{
+    const SoftwareScene &scene = *currentScene;
+    const int tileX0 = (tile % tilesX) * TILE_SIZE;
+    const int tileY0 = (tile / tilesX) * TILE_SIZE;
+    const int tileX1 = tileX0 + TILE_SIZE < frameWidth ? tileX0 + TILE_SIZE : frameWidth;
+    const int tileY1 = tileY0 + TILE_SIZE < frameHeight ? tileY0 + TILE_SIZE : frameHeight;
+
+    // same order as the GL renderer: background, particles, paddles and balls, text
+    for (int y = tileY0; y < tileY1; y++)
+    {
+        memcpy(framePixels + y * frameStride + tileX0, &resampledBackground[y * frameWidth + tileX0], (tileX1 - tileX0) * sizeof(uint32_t));
+    }
+
+    drawRects(scene.AdditiveRects, additiveTileRects.data() + additiveTileStart[tile], additiveTileStart[tile + 1] - additiveTileStart[tile],
+              tileX0, tileY0, tileX1, tileY1, addSpan);
+    drawRects(scene.Rects, opaqueTileRects.data() + opaqueTileStart[tile], opaqueTileStart[tile + 1] - opaqueTileStart[tile],
+              tileX0, tileY0, tileX1, tileY1, fillSpan);
+
+    for (size_t i = 0; i < scene.Glyphs.size(); i++)
+    {
+        drawGlyph(scene.Glyphs[i], tileX0, tileY0, tileX1, tileY1);
+    }
+}
+
+static void renderTiles()
+{
+    const int tileCount = tilesX * tilesY;
+    int tile;
+    while ((tile = nextTile.fetch_add(1, std::memory_order_relaxed)) < tileCount)
+    {
+        renderTile(tile);
+    }
+}
+
+static void tileWorkerLoop()
+{
+    unsigned int seenGeneration = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(tileMutex);
+            tileFrameStart.wait(lock, [&]
+                                { return tileWorkersStopping || frameGeneration != seenGeneration; });
+            if (tileWorkersStopping)
+                return;
+            seenGeneration = frameGeneration;
+        }
+
+        renderTiles();
+
+        {
+            std::lock_guard<std::mutex> lock(tileMutex);
+            tileWorkersDone++;
+        }
+        tileFrameDone.notify_one();
+    }
+}
+
+bool softwareRendererInit(int width, int height, const unsigned char *background, int backgroundWidth, int backgroundHeight, int backgroundChannels, int threads)
+{
+    if (width <= 0 || height <= 0 || !background || backgroundChannels < 3)
+    {
+        std::cout << "Software renderer: invalid frame or background" << std::endl;
+        return false;
+    }
+
+    frameWidth = width;
+    frameHeight = height;
+    tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+#ifdef SOFTWARE_RENDERER_AVX2
+    if (__builtin_cpu_supports("avx2"))
+    {
+        fillSpan = fillSpanAVX2;
+        addSpan = addSpanAVX2;
+    }
+#endif
+
+    // The background never changes, so it is bilinearly resampled to the frame size once instead of
+    // every frame. Like the GL quad, texture row 0 is at the bottom of the screen and it wraps.
+    resampledBackground.resize(width * height);
+    for (int y = 0; y < height; y++)
+    {
+        float textureY = (1.0f - (y + 0.5f) / height) * backgroundHeight - 0.5f;
+        int row0 = static_cast<int>(std::floor(textureY));
+        float fractionY = textureY - row0;
+        int row1 = ((row0 + 1) % backgroundHeight + backgroundHeight) % backgroundHeight;
+        row0 = (row0 % backgroundHeight + backgroundHeight) % backgroundHeight;
+        for (int x = 0; x < width; x++)
+        {
+            float textureX = (x + 0.5f) / width * backgroundWidth - 0.5f;
+            int column0 = static_cast<int>(std::floor(textureX));
+            float fractionX = textureX - column0;
+            int column1 = ((column0 + 1) % backgroundWidth + backgroundWidth) % backgroundWidth;
+            column0 = (column0 % backgroundWidth + backgroundWidth) % backgroundWidth;
+
+            uint32_t pixel = 0xFF000000u;
+            for (int channel = 0; channel < 3; channel++)
+            {
+                float topLeft = background[(row0 * backgroundWidth + column0) * backgroundChannels + channel];
+                float topRight = background[(row0 * backgroundWidth + column1) * backgroundChannels + channel];
+                float bottomLeft = background[(row1 * backgroundWidth + column0) * backgroundChannels + channel];
+                float bottomRight = background[(row1 * backgroundWidth + column1) * backgroundChannels + channel];
+                float top = topLeft + (topRight - topLeft) * fractionX;
+                float bottom = bottomLeft + (bottomRight - bottomLeft) * fractionX;
+                pixel |= static_cast<uint32_t>(top + (bottom - top) * fractionY + 0.5f) << (16 - 8 * channel);
+            }
+            resampledBackground[y * width + x] = pixel;
+        }
+    }
+
+    // the calling thread renders tiles too
+    for (int i = 1; i < threads; i++)
+    {
+        tileWorkers.push_back(std::thread(tileWorkerLoop));
+    }
+    return true;
+}
+
+void softwareRendererSetTarget(uint32_t *pixels, int stride)
+{
+    framePixels = pixels;
+    frameStride = stride;
+}
+
+void softwareRenderFrame(const SoftwareScene &scene)
+{
+    binRects(scene.AdditiveRects, additiveTileStart, additiveTileRects);
+    binRects(scene.Rects, opaqueTileStart, opaqueTileRects);
+
+    currentScene = &scene;
+    nextTile.store(0, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(tileMutex);
+        tileWorkersDone = 0;
+        frameGeneration++;
+    }
+    tileFrameStart.notify_all();
+
+    renderTiles();
+
+    std::unique_lock<std::mutex> lock(tileMutex);
+    tileFrameDone.wait(lock, []
+                       { return tileWorkersDone == tileWorkers.size(); });
+}
+
+void softwareRendererShutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(tileMutex);
+        tileWorkersStopping = true;
+    }
+    tileFrameStart.notify_all();
+    for (size_t i = 0; i < tileWorkers.size(); i++)
+    {
+        tileWorkers[i].join();
+    }
+    tileWorkers.clear();
+}
+
+#ifdef PONG_SOFTWARE_X11
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdlib>
+
+static Display *display = nullptr;
+static Window window;
+static GC graphicsContext;
+static XImage *windowImage = nullptr;
+static XShmSegmentInfo sharedMemory;
+static bool usingSharedMemory = false;
+static Atom deleteWindowAtom;
+static int windowWidth = 0;
+static int windowHeight = 0;
+static bool sharedMemoryAttachFailed = false;
+static int sharedMemoryCompletionEvent = 0;
+static bool presentPending = false; // Set until the server reports it has read the shared memory image
+static int wakePipe[2] = {-1, -1};  // Written by softwareWindowPostEmptyEvent() to wake the event wait
+
+static int sharedMemoryErrorHandler(Display *errorDisplay, XErrorEvent *error)
+{
+    sharedMemoryAttachFailed = true;
+    return 0;
+}
+
+// Create windowImage in a shared memory segment. Fails (leaving nothing behind) when the segment
+// can't be created or the server can't attach it, e.g. a remote display over ssh -X answers
+// XShmAttach with BadAccess.
+static bool createSharedMemoryImage(Visual *visual, int depth, int width, int height)
+{
+    windowImage = XShmCreateImage(display, visual, depth, ZPixmap, NULL, &sharedMemory, width, height);
+    if (!windowImage)
+        return false;
+    if (windowImage->bits_per_pixel != 32)
+    {
+        XDestroyImage(windowImage);
+        windowImage = nullptr;
+        return false;
+    }
+
+    sharedMemory.shmid = shmget(IPC_PRIVATE, windowImage->bytes_per_line * windowImage->height, IPC_CREAT | 0600);
+    if (sharedMemory.shmid == -1)
+    {
+        XDestroyImage(windowImage);
+        windowImage = nullptr;
+        return false;
+    }
+    sharedMemory.shmaddr = static_cast<char *>(shmat(sharedMemory.shmid, NULL, 0));
+    if (sharedMemory.shmaddr == reinterpret_cast<char *>(-1))
+    {
+        shmctl(sharedMemory.shmid, IPC_RMID, NULL);
+        XDestroyImage(windowImage);
+        windowImage = nullptr;
+        return false;
+    }
+    windowImage->data = sharedMemory.shmaddr;
+    sharedMemory.readOnly = False;
+
+    // attach errors arrive asynchronously, catch them with a temporary handler until XSync returns
+    sharedMemoryAttachFailed = false;
+    XErrorHandler previousHandler = XSetErrorHandler(sharedMemoryErrorHandler);
+    Status attached = XShmAttach(display, &sharedMemory);
+    XSync(display, False);
+    XSetErrorHandler(previousHandler);
+    shmctl(sharedMemory.shmid, IPC_RMID, NULL); // freed once both sides detach
+    if (!attached || sharedMemoryAttachFailed)
+    {
+        windowImage->data = nullptr; // not malloc'd, XDestroyImage must not free it
+        XDestroyImage(windowImage);
+        windowImage = nullptr;
+        shmdt(sharedMemory.shmaddr);
+        return false;
+    }
+    return true;
+}
+
+bool softwareWindowOpen(int width, int height, const char *title)
+{
+    display = XOpenDisplay(NULL);
+    if (!display)
+    {
+        std::cout << "Failed to open X display" << std::endl;
+        return false;
+    }
+
+    int screen = DefaultScreen(display);
+    Visual *visual = DefaultVisual(display, screen);
+    int depth = DefaultDepth(display, screen);
+    // frames are written as 0xAARRGGBB words, so the visual has to use the same layout
+    if ((depth != 24 && depth != 32) || visual->red_mask != 0xFF0000 || visual->green_mask != 0xFF00 || visual->blue_mask != 0xFF)
+    {
+        std::cout << "Unsupported X visual: depth " << depth << ", masks " << std::hex << visual->red_mask << " "
+                  << visual->green_mask << " " << visual->blue_mask << std::dec << " (needs 24 or 32 bit RGB)" << std::endl;
+        XCloseDisplay(display);
+        display = nullptr;
+        return false;
+    }
+
+    windowWidth = width;
+    windowHeight = height;
+    window = XCreateSimpleWindow(display, RootWindow(display, screen), 0, 0, width, height, 0, BlackPixel(display, screen), BlackPixel(display, screen));
+    XStoreName(display, window, title);
+    XSelectInput(display, window, KeyPressMask | KeyReleaseMask | StructureNotifyMask);
+
+    // fixed size window, like the GL one renders a fixed size frame
+    XSizeHints *sizeHints = XAllocSizeHints();
+    sizeHints->flags = PMinSize | PMaxSize;
+    sizeHints->min_width = sizeHints->max_width = width;
+    sizeHints->min_height = sizeHints->max_height = height;
+    XSetWMNormalHints(display, window, sizeHints);
+    XFree(sizeHints);
+
+    deleteWindowAtom = XInternAtom(display, "WM_DELETE_WINDOW", False);
+    XSetWMProtocols(display, window, &deleteWindowAtom, 1);
+    XkbSetDetectableAutoRepeat(display, True, NULL); // no fake releases while a key is held
+    graphicsContext = DefaultGC(display, screen);
+    XMapWindow(display, window);
+
+    // render straight into a shared memory image when the server supports it, otherwise send the
+    // pixels with XPutImage
+    usingSharedMemory = XShmQueryExtension(display) && createSharedMemoryImage(visual, depth, width, height);
+    sharedMemoryCompletionEvent = usingSharedMemory ? XShmGetEventBase(display) + ShmCompletion : 0;
+    presentPending = false;
+    if (!usingSharedMemory)
+    {
+        char *data = static_cast<char *>(malloc(width * height * sizeof(uint32_t)));
+        windowImage = data ? XCreateImage(display, visual, depth, ZPixmap, 0, data, width, height, 32, 0) : nullptr;
+        if (!windowImage || windowImage->bits_per_pixel != 32)
+        {
+            std::cout << "Failed to create the window image" << std::endl;
+            if (windowImage)
+                XDestroyImage(windowImage); // also frees the pixel data
+            else
+                free(data);
+            windowImage = nullptr;
+            XDestroyWindow(display, window);
+            XCloseDisplay(display);
+            display = nullptr;
+            return false;
+        }
+    }
+
+    // non-blocking so a burst of wake-ups never blocks the render thread and draining stops when empty
+    if (pipe(wakePipe) == 0)
+    {
+        fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+    }
+    return true;
+}
+
+bool softwareWindowReady()
+{
+    return !presentPending;
+}
+
+void softwareWindowPresent(const uint32_t *pixels)
+{
+    for (int y = 0; y < windowHeight; y++)
+    {
+        memcpy(windowImage->data + y * windowImage->bytes_per_line, pixels + y * windowWidth, windowWidth * sizeof(uint32_t));
+    }
+
+    // XPutImage copies the pixels into the request right away, a shared memory image is read by the
+    // server later and reports a completion event once it's free to be written again
+    if (usingSharedMemory)
+    {
+        XShmPutImage(display, window, graphicsContext, windowImage, 0, 0, 0, 0, windowWidth, windowHeight, True);
+        presentPending = true;
+    }
+    else
+    {
+        XPutImage(display, window, graphicsContext, windowImage, 0, 0, 0, 0, windowWidth, windowHeight);
+    }
+    XFlush(display);
+}
+
+static SoftwareKey softwareKeyFromKeysym(KeySym keysym)
+{
+    switch (keysym)
+    {
+    case XK_Escape:
+        return SOFTWARE_KEY_ESCAPE;
+    case XK_Return:
+        return SOFTWARE_KEY_ENTER;
+    case XK_Up:
+        return SOFTWARE_KEY_UP;
+    case XK_Down:
+        return SOFTWARE_KEY_DOWN;
+    case XK_w:
+        return SOFTWARE_KEY_W;
+    case XK_s:
+        return SOFTWARE_KEY_S;
+    case XK_r:
+        return SOFTWARE_KEY_R;
+    case XK_b:
+        return SOFTWARE_KEY_B;
+    case XK_equal:
+        return SOFTWARE_KEY_EQUAL;
+    case XK_minus:
+        return SOFTWARE_KEY_MINUS;
+    default:
+        return SOFTWARE_KEY_UNKNOWN;
+    }
+}
+
+bool softwareWindowWaitEvents(void (*keyCallback)(SoftwareKey key, bool pressed))
+{
+    // sleep until the server sends something or another thread posts an empty event
+    if (!XPending(display))
+    {
+        pollfd descriptors[2] = {{ConnectionNumber(display), POLLIN, 0}, {wakePipe[0], POLLIN, 0}};
+        poll(descriptors, wakePipe[0] == -1 ? 1 : 2, -1);
+    }
+    char wakeBytes[64];
+    while (wakePipe[0] != -1 && read(wakePipe[0], wakeBytes, sizeof(wakeBytes)) > 0)
+    {
+    }
+
+    while (XPending(display))
+    {
+        XEvent event;
+        XNextEvent(display, &event);
+        if (event.type == KeyPress || event.type == KeyRelease)
+        {
+            keyCallback(softwareKeyFromKeysym(XLookupKeysym(&event.xkey, 0)), event.type == KeyPress);
+        }
+        else if (event.type == ClientMessage && static_cast<Atom>(event.xclient.data.l[0]) == deleteWindowAtom)
+        {
+            return false;
+        }
+        else if (usingSharedMemory && event.type == sharedMemoryCompletionEvent)
+        {
+            presentPending = false;
+        }
+    }
+    return true;
+}
+
+void softwareWindowPostEmptyEvent()
+{
+    if (wakePipe[1] != -1)
+    {
+        char wakeByte = 0;
+        ssize_t written = write(wakePipe[1], &wakeByte, 1); // a full pipe already wakes the wait
+        (void)written;
+    }
+}
+
+void softwareWindowClose()
+{
+    if (!display)
+        return;
+    if (usingSharedMemory)
+    {
+        XShmDetach(display, &sharedMemory);
+        XDestroyImage(windowImage);
+        shmdt(sharedMemory.shmaddr);
+    }
+    else
+    {
+        XDestroyImage(windowImage); // also frees the pixel data
+    }
+    XDestroyWindow(display, window);
+    XCloseDisplay(display);
+    display = nullptr;
+    for (int i = 0; i < 2; i++)
+    {
+        if (wakePipe[i] != -1)
+            close(wakePipe[i]);
+        wakePipe[i] = -1;
+    }
+}
+#else
+bool softwareWindowOpen(int width, int height, const char *title)
+{
+    std::cout << "Software window output needs a build with -DPONG_SOFTWARE_X11 (and -lX11 -lXext)" << std::endl;
+    return false;
+}
+
+bool softwareWindowReady()
+{
+    return false;
+}
+
+void softwareWindowPresent(const uint32_t *pixels)
+{
+}
+
+bool softwareWindowWaitEvents(void (*keyCallback)(SoftwareKey key, bool pressed))
+{
+    return false;
+}
+
+void softwareWindowPostEmptyEvent()
+{
+}
+
+void softwareWindowClose()
+{
+}
+#endif
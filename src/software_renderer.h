@@ -0,0 +1,74 @@
+#ifndef SOFTWARE_RENDERER_H
+#define SOFTWARE_RENDERER_H
+
+#include <cstdint>
+#include <vector>
+
+// CPU rasterizer for the pong scene, used when OpenGL isn't available. The frame is split into
+// tiles rendered in parallel; each tile copies the (pre-resampled) background and draws the
+// primitives overlapping it. Pixels are 32-bit 0xAARRGGBB, rows from the top of the screen.
+
+// Axis-aligned rectangle in pixels covering [X0, X1) x [Y0, Y1)
+struct SoftwareRect
+{
+    int X0, Y0, X1, Y1;
+    uint32_t Color;
+};
+
+// Glyph quad in pixels, sampled bilinearly from a single-channel atlas page
+struct SoftwareGlyph
+{
+    float X0, Y0, X1, Y1;
+    float U0, V0, U1, V1; // Texture coordinates in the atlas page, 0 to 1
+    const unsigned char *Page;
+    int PageSize; // Width and height of the atlas page in pixels
+    uint32_t Color;
+};
+
+struct SoftwareScene
+{
+    std::vector<SoftwareRect> AdditiveRects; // Color already multiplied by alpha, added with saturation (particles)
+    std::vector<SoftwareRect> Rects;         // Opaque (paddles and balls)
+    std::vector<SoftwareGlyph> Glyphs;       // Alpha blended over everything else (text)
+
+    void clear()
+    {
+        AdditiveRects.clear();
+        Rects.clear();
+        Glyphs.clear();
+    }
+};
+
+// Set up the renderer for a width x height frame. The background image (RGB or RGBA rows, first
+// row at the bottom of the screen like the GL texture) is resampled once here.
+bool softwareRendererInit(int width, int height, const unsigned char *background, int backgroundWidth, int backgroundHeight, int backgroundChannels, int threads);
+void softwareRendererSetTarget(uint32_t *pixels, int stride);
+void softwareRenderFrame(const SoftwareScene &scene);
+void softwareRendererShutdown();
+
+// Keys reported by the software window, every other key comes through as SOFTWARE_KEY_UNKNOWN
+enum SoftwareKey
+{
+    SOFTWARE_KEY_UNKNOWN,
+    SOFTWARE_KEY_ESCAPE,
+    SOFTWARE_KEY_ENTER,
+    SOFTWARE_KEY_UP,
+    SOFTWARE_KEY_DOWN,
+    SOFTWARE_KEY_W,
+    SOFTWARE_KEY_S,
+    SOFTWARE_KEY_R,
+    SOFTWARE_KEY_B,
+    SOFTWARE_KEY_EQUAL,
+    SOFTWARE_KEY_MINUS
+};
+
+// Window output through X11 with MIT-SHM (when built with -DPONG_SOFTWARE_X11). Every function but
+// softwareWindowPostEmptyEvent() must be called from the thread that opened the window.
+bool softwareWindowOpen(int width, int height, const char *title);
+bool softwareWindowReady();                         // false while the server still reads the last presented frame
+void softwareWindowPresent(const uint32_t *pixels); // Copies a width x height frame, rows packed, and shows it
+bool softwareWindowWaitEvents(void (*keyCallback)(SoftwareKey key, bool pressed)); // Waits for events, false once the window is closed
+void softwareWindowPostEmptyEvent();                // Wakes softwareWindowWaitEvents(), from any thread
+void softwareWindowClose();
+
+#endif